@@ -0,0 +1,238 @@
+import random
+import sys
+
+import click
+
+# NOTE: the generated programs are meant for stress testing of Morpheus, they
+#       are valid MPI programs but they do not compute anything meaningful.
+#       The communication follows a ring (left/right neighbours) or a star
+#       (rank 0 and the others). Each ring construct receives from the left
+#       as many messages as it sends to the right, and all the ranks execute
+#       the same ring constructs, hence the programs do not deadlock.
+
+HEADER = """\
+#include "mpi.h"
+
+enum {{ TAG_RING, TAG_STAR }};
+
+static int data[{data_size}];
+
+"""
+
+MAIN_PROLOGUE = """\
+int main (int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  int left = (rank + size - 1) % size;
+  int right = (rank + 1) % size;
+"""
+
+MAIN_EPILOGUE = """\
+  MPI_Finalize();
+  return 0;
+}
+"""
+
+DATA_SIZE = 64
+
+
+class Writer:
+    def __init__(self):
+        self.lines = []
+        self.indent = 1
+
+    def line(self, text):
+        self.lines.append("  " * self.indent + text)
+
+    def block(self, head, body_fn, tail="}"):
+        self.line(head)
+        self.indent += 1
+        body_fn()
+        self.indent -= 1
+        self.line(tail)
+
+    def text(self):
+        return "\n".join(self.lines) + "\n"
+
+
+class Generator:
+    """ Emits the MPI constructs of the program. Each construct reports the
+        number of MPI call sites it adds, so that the total can be controlled. """
+
+    def __init__(self, rnd, array_size):
+        self.rnd = rnd
+        self.array_size = array_size
+        self.data_size = max(DATA_SIZE, array_size)
+        self.next_id = 0
+
+    def fresh(self, prefix):
+        self.next_id += 1
+        return "{}{}".format(prefix, self.next_id)
+
+    def slot(self):
+        return "&data[{}]".format(self.rnd.randrange(self.data_size))
+
+    def slots(self, count):
+        """ Distinct slots, so the pending requests do not share a buffer. """
+        first = self.rnd.randrange(self.data_size)
+        return ["&data[{}]".format((first + i) % self.data_size) for i in range(count)]
+
+    # ------------------------------------------------------------------ #
+    # constructs
+
+    def nonblocking_pair(self, w):
+        """ Irecv from the left and Isend to the right neighbour completed
+            by Waitall (3 call sites). """
+        rqsts = self.fresh("rqsts")
+        recv_slot, send_slot = self.slots(2)
+        w.line("MPI_Request {}[2];".format(rqsts))
+        w.line("MPI_Irecv({}, 1, MPI_INT, left, TAG_RING, MPI_COMM_WORLD, &{}[0]);".format(recv_slot, rqsts))
+        w.line("MPI_Isend({}, 1, MPI_INT, right, TAG_RING, MPI_COMM_WORLD, &{}[1]);".format(send_slot, rqsts))
+        w.line("MPI_Waitall(2, {}, MPI_STATUSES_IGNORE);".format(rqsts))
+        return 3
+
+    def request_array(self, w):
+        """ Unrolled exchange with both neighbours completed by Waitall (K + 1 call sites).
+            The size is even, so each Irecv is matched by an Isend. """
+        rqsts = self.fresh("rqsts")
+        size = self.array_size
+        w.line("MPI_Request {}[{}];".format(rqsts, size))
+        for i, slot in enumerate(self.slots(size)):
+            if i % 2 == 0:
+                w.line("MPI_Irecv({}, 1, MPI_INT, left, TAG_RING, MPI_COMM_WORLD, &{}[{}]);".format(slot, rqsts, i))
+            else:
+                w.line("MPI_Isend({}, 1, MPI_INT, right, TAG_RING, MPI_COMM_WORLD, &{}[{}]);".format(slot, rqsts, i))
+        w.line("MPI_Waitall({}, {}, MPI_STATUSES_IGNORE);".format(size, rqsts))
+        return size + 1
+
+    def rank_branch(self, w):
+        """ Star exchange with rank 0 depending on the rank (3 call sites). """
+        count = [0]
+
+        def root():
+            src = self.fresh("src")
+            def body():
+                w.line("MPI_Recv({}, 1, MPI_INT, {}, TAG_STAR, MPI_COMM_WORLD, MPI_STATUS_IGNORE);".format(self.slot(), src))
+            w.block("for (int {0} = 1; {0} < size; {0}++) {{".format(src), body)
+            count[0] += 1
+
+        def others():
+            rqst = self.fresh("rqst")
+            w.line("MPI_Request {};".format(rqst))
+            w.line("MPI_Isend(&rank, 1, MPI_INT, 0, TAG_STAR, MPI_COMM_WORLD, &{});".format(rqst))
+            w.line("MPI_Wait(&{}, MPI_STATUS_IGNORE);".format(rqst))
+            count[0] += 2
+
+        w.block("if (rank == 0) {", root, tail="} else {")
+        w.indent += 1
+        others()
+        w.indent -= 1
+        w.line("}")
+        return count[0]
+
+    def data_branch(self, w):
+        """ Branch on data without any MPI call (3 basic blocks). """
+        i, j = self.rnd.randrange(self.data_size), self.rnd.randrange(self.data_size)
+        w.block("if (data[{}] > data[{}]) {{".format(i, j),
+                lambda: w.line("data[{}] += data[{}];".format(i, j)), tail="} else {")
+        w.indent += 1
+        w.line("data[{}] -= 1;".format(j))
+        w.indent -= 1
+        w.line("}")
+        return 0
+
+    def loop(self, w, body_fn):
+        """ Loop around the given construct. """
+        it = self.fresh("i")
+        result = [0]
+        def body():
+            result[0] = body_fn(w)
+        w.block("for (int {0} = 0; {0} < {1}; {0}++) {{".format(it, self.rnd.randint(2, 8)), body)
+        return result[0]
+
+
+def generate_program(call_sites=100, branches=10, loops=10, request_arrays=5,
+                     array_size=8, call_depth=0, calls=0, basic_blocks=0, seed=0):
+    """ Returns a source of an MPI program with (approximately) the given number
+        of MPI call sites, rank-dependent branches, loops, request arrays,
+        and extra basic blocks. `calls` constructs are moved into functions
+        reached via a chain of `call_depth` calls from the MPI scope. """
+    rnd = random.Random(seed)
+    gen = Generator(rnd, max(2, array_size + array_size % 2)) # rounded up to even
+
+    # the fixed constructs, the rest of call sites is filled by nonblocking pairs
+    constructs = [gen.rank_branch] * branches + [gen.request_array] * request_arrays
+    fixed = 3 * branches + (gen.array_size + 1) * request_arrays
+    constructs += [gen.nonblocking_pair] * max(0, (call_sites - fixed) // 3)
+    constructs += [gen.data_branch] * (basic_blocks // 3)
+    rnd.shuffle(constructs)
+
+    # NOTE: a loop wraps the construct at the chosen position, if a position
+    #       is chosen more than once, the loops are nested
+    wrapped = [0] * len(constructs)
+    for _ in range(loops if constructs else 0):
+        wrapped[rnd.randrange(len(constructs))] += 1
+
+    called = set(rnd.sample(range(len(constructs)), min(calls, len(constructs)))) if call_depth > 0 else set()
+
+    functions = []
+    main = Writer()
+    total = 0
+
+    def emit(w, idx):
+        fn = constructs[idx]
+        for _ in range(wrapped[idx]):
+            fn = (lambda inner: lambda w: gen.loop(w, inner))(fn)
+        return fn(w)
+
+    for idx in range(len(constructs)):
+        if idx not in called:
+            total += emit(main, idx)
+            continue
+
+        # chain of functions: chain_N_0 -> chain_N_1 -> ... -> the construct
+        chain = gen.fresh("chain")
+        for depth in range(call_depth - 1, -1, -1):
+            f = Writer()
+            name = "{}_{}".format(chain, depth)
+            if depth == call_depth - 1:
+                total += emit(f, idx)
+            else:
+                f.line("{}_{}(rank, size, left, right);".format(chain, depth + 1))
+            functions.append("static void {}(int rank, int size, int left, int right) {{\n{}}}\n\n".format(name, f.text()))
+        main.line("{}_0(rank, size, left, right);".format(chain))
+
+    source = [HEADER.format(data_size=gen.data_size)]
+    source += functions
+    source += [MAIN_PROLOGUE, main.text(), MAIN_EPILOGUE]
+    return "".join(source), total
+
+
+@click.command()
+@click.option("-n", "--call-sites", default=100, help="Number of MPI call sites (approximately).")
+@click.option("--branches", default=10, help="Number of rank-dependent branches.")
+@click.option("--loops", default=10, help="Number of loops (they may nest).")
+@click.option("--request-arrays", default=5, help="Number of request arrays completed by MPI_Waitall.")
+@click.option("--array-size", default=8, help="Size of request arrays (rounded up to even).")
+@click.option("--call-depth", default=0, help="Depth of call chains leading to the called constructs.")
+@click.option("--calls", default=0, help="Number of constructs placed at the end of call chains.")
+@click.option("--basic-blocks", default=0, help="Number of extra basic blocks (branches on data).")
+@click.option("--seed", default=0, help="Seed of the random generator.")
+@click.option("-o", "--output", default=None, type=str, help="Output file (stdout if not set).")
+def generate_mpi_program(call_sites, branches, loops, request_arrays, array_size,
+                         call_depth, calls, basic_blocks, seed, output):
+    """ Generates a synthetic MPI program for stress testing. """
+    source, total = generate_program(call_sites, branches, loops, request_arrays,
+                                     array_size, call_depth, calls, basic_blocks, seed)
+    if output is None:
+        sys.stdout.write(source)
+    else:
+        with open(output, "w") as f:
+            f.write(source)
+    print("MPI call sites: {}".format(total), file=sys.stderr)
+
+if __name__ == "__main__":
+    generate_mpi_program()
@@ -0,0 +1,454 @@
+//===----------------------------------------------------------------------===//
+//
+// morpheus-bench
+//
+// Microbenchmarks of the CommunicationNet algorithms. Synthetic nets of
+// various shapes and sizes are built directly through the CommunicationNet
+// API and the particular algorithms are timed on them. The times are reported
+// per element of the net (places, transitions and edges) together with the
+// complexity that fits the measured times the best, hence a quadratic path
+// shows up as O(N^2) even if the absolute times are still small.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "morpheus/ADT/CommunicationNet.hpp"
+#include "morpheus/Formats/DotGraph.hpp"
+#include "morpheus/Formats/PlainText.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <sstream>
+
+using namespace llvm;
+using namespace cn;
+
+static cl::list<std::string> shapes_arg(
+    "shape", cl::CommaSeparated,
+    cl::desc("Shapes of nets: chain, diamonds, loops, parallel (default all)"));
+
+static cl::list<std::string> ops_arg(
+    "op", cl::CommaSeparated,
+    cl::desc("Benchmarked algorithms: collapse, reduce_parallel_paths, "
+             "reduce_redundant_edges, resolve_unresolved, takeover, format_dot, "
+             "format_plain (default all)"));
+
+static cl::opt<unsigned> min_size_arg(
+    "min-size", cl::init(64),
+    cl::desc("The smallest number of shape units (e.g., diamonds) of a net"));
+
+static cl::opt<unsigned> max_size_arg(
+    "max-size", cl::init(512),
+    cl::desc("The largest number of shape units, the sizes are doubled up to it"));
+
+static cl::opt<unsigned> repetitions_arg(
+    "repetitions", cl::init(3),
+    cl::desc("Number of runs of each measurement (the fastest one is reported)"));
+
+namespace {
+
+  // NOTE: reduce_parallel_paths and reduce_redundant_edges are normally run
+  //       only within collapse(), hence they are exposed here.
+  struct BenchNet final : public CommunicationNet {
+    using CommunicationNet::reduce_parallel_paths;
+
+    void reduce_redundant_edges() {
+      CommunicationNet::reduce_redundant_edges(collect_all_edges());
+    }
+
+    size_t num_elements() const {
+      return num_places() + num_transitions() + num_edges();
+    }
+  };
+
+  // -------------------------------------------------------------------------- //
+  // shapes of nets
+
+  // NOTE: an unresolved place and transition are matched via the address of an
+  //       MPI request, hence each pair gets a distinct constant.
+  struct RequestPool {
+    const Value &get(size_t i) {
+      return *ConstantInt::get(Type::getInt64Ty(ctx), i);
+    }
+
+    LLVMContext ctx;
+  };
+
+  using UnresolvedPairs = std::vector<std::pair<Place *, Transition *>>;
+
+  // NOTE: the transitions are added in the reverse order, so the matching of
+  //       unresolved elements does not find its counterpart immediately.
+  void add_unresolved(BenchNet &net, const UnresolvedPairs &pairs, RequestPool &requests) {
+    auto resolve = [](CommunicationNet &cn, Place &p, Transition &t, UnresolvedConnect &) {
+      cn.add_input_edge(p, t, "x");
+    };
+    for (size_t i = 0; i < pairs.size(); i++) {
+      net.add_unresolved_place(*pairs[i].first, requests.get(i), resolve);
+    }
+    for (size_t i = pairs.size(); i-- > 0; ) {
+      net.add_unresolved_transition(*pairs[i].second, requests.get(i));
+    }
+  }
+
+  // p -> q -> t -> p' -> ..., where t reads and writes a data place
+  // and p -> q is collapsible
+  void build_chain(BenchNet &net, size_t n, RequestPool &requests) {
+    UnresolvedPairs pairs;
+    Place *p = &net.add_place("Unit", "", "entry");
+    for (size_t i = 0; i < n; i++) {
+      Place &q = net.add_place("Unit", "");
+      Transition &t = net.add_transition(ConditionList());
+      Place &data = net.add_place("Int", "0");
+      Place &next = net.add_place("Unit", "");
+
+      net.add_cf_edge(*p, q);
+      net.add_cf_edge(q, t);
+      net.add_cf_edge(t, next);
+      net.add_input_edge(data, t, "x");
+      net.add_output_edge(t, data, "x + 1");
+
+      pairs.emplace_back(&data, &t);
+      p = &next;
+    }
+    add_unresolved(net, pairs, requests);
+  }
+
+  // sequence of if-then-else: p -> {a, b} -> q -> ..., where q is also
+  // read twice by the same edge (a redundant one)
+  void build_diamonds(BenchNet &net, size_t n, RequestPool &requests) {
+    UnresolvedPairs pairs;
+    Place *p = &net.add_place("Unit", "", "entry");
+    for (size_t i = 0; i < n; i++) {
+      Transition &a = net.add_transition({"x > 0"});
+      Transition &b = net.add_transition({"x <= 0"});
+      Place &q = net.add_place("Unit", "");
+      Transition &send = net.add_transition(ConditionList());
+
+      net.add_cf_edge(*p, a);
+      net.add_cf_edge(*p, b);
+      net.add_cf_edge(a, q);
+      net.add_cf_edge(b, q);
+      net.add_input_edge(q, send, "x");
+      net.add_input_edge(q, send, "x");
+
+      pairs.emplace_back(&q, &send);
+      p = &q;
+    }
+    add_unresolved(net, pairs, requests);
+  }
+
+  // n nested loops shaped as exposed by CFG_CN (a Boolean header place
+  // with `true` and `false` branches), each one with its own latch
+  void build_loops(BenchNet &net, size_t n, RequestPool &requests) {
+    UnresolvedPairs pairs;
+    std::vector<Place *> headers;
+    std::vector<Transition *> exits;
+
+    Place *entry = &net.add_place("Unit", "", "entry");
+    for (size_t i = 0; i < n; i++) {
+      Place &header = net.add_place("Bool", "", "test_loop");
+      Transition &body = net.add_transition(ConditionList());
+      Transition &exit = net.add_transition(ConditionList());
+      Place &body_entry = net.add_place("Unit", "");
+
+      net.add_cf_edge(*entry, header);
+      net.add_input_edge(header, body, "true");
+      net.add_input_edge(header, exit, "false");
+      net.add_cf_edge(body, body_entry);
+
+      headers.push_back(&header);
+      exits.push_back(&exit);
+      pairs.emplace_back(&body_entry, &body);
+      entry = &body_entry;
+    }
+    if (n > 0) {
+      net.add_cf_edge(*entry, *headers.back()); // the innermost back edge
+    }
+
+    for (size_t i = n; i-- > 0; ) {
+      Place &latch = net.add_place("Unit", "");
+      Place &latch_exit = net.add_place("Unit", "");
+      net.add_cf_edge(*exits[i], latch);
+      net.add_cf_edge(latch, latch_exit);
+      if (i > 0) {
+        net.add_cf_edge(latch_exit, *headers[i - 1]); // back edge of the outer loop
+      }
+    }
+    add_unresolved(net, pairs, requests);
+  }
+
+  // n parallel control flow paths between a fork and a join place
+  void build_parallel(BenchNet &net, size_t n, RequestPool &requests) {
+    UnresolvedPairs pairs;
+    Place &fork = net.add_place("Unit", "", "fork");
+    Place &join = net.add_place("Unit", "", "join");
+    for (size_t i = 0; i < n; i++) {
+      Transition &t = net.add_transition(ConditionList());
+      net.add_cf_edge(fork, t);
+      net.add_cf_edge(t, join);
+
+      pairs.emplace_back(&fork, &t);
+    }
+    add_unresolved(net, pairs, requests);
+  }
+
+  using BuildFnTy = void (*)(BenchNet &, size_t, RequestPool &);
+
+  struct Shape {
+    const char *name;
+    BuildFnTy build;
+  };
+
+  const Shape shapes[] = {
+    {"chain", build_chain},
+    {"diamonds", build_diamonds},
+    {"loops", build_loops},
+    {"parallel", build_parallel},
+  };
+
+  // -------------------------------------------------------------------------- //
+  // benchmarked algorithms
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Measurement {
+    size_t size;       // number of shape units
+    size_t elements;   // places, transitions and edges of the net
+    double time_ns;
+  };
+
+  // NOTE: the net is built before each run, only the algorithm is timed
+  using RunFnTy = Measurement (*)(const Shape &, size_t, RequestPool &);
+
+  template <typename Fn>
+  Measurement time_on_net(const Shape &shape, size_t n, RequestPool &requests, Fn fn) {
+    BenchNet net;
+    shape.build(net, n, requests);
+    size_t elements = net.num_elements();
+
+    auto start = Clock::now();
+    fn(net);
+    std::chrono::duration<double, std::nano> time = Clock::now() - start;
+    return {n, elements, time.count()};
+  }
+
+  template <typename Fmt>
+  Measurement time_format(const Shape &shape, size_t n, RequestPool &requests) {
+    BenchNet net;
+    shape.build(net, n, requests);
+    size_t elements = net.num_elements();
+
+    AddressableCN acn("bench");
+    acn.takeover(move(net));
+
+    std::ostringstream os;
+    auto start = Clock::now();
+    Fmt().format(os, acn);
+    std::chrono::duration<double, std::nano> time = Clock::now() - start;
+    return {n, elements, time.count()};
+  }
+
+  Measurement run_collapse(const Shape &shape, size_t n, RequestPool &requests) {
+    return time_on_net(shape, n, requests, [](BenchNet &net) { net.collapse(); });
+  }
+
+  Measurement run_reduce_parallel_paths(const Shape &shape, size_t n, RequestPool &requests) {
+    return time_on_net(shape, n, requests, [](BenchNet &net) { net.reduce_parallel_paths(); });
+  }
+
+  Measurement run_reduce_redundant_edges(const Shape &shape, size_t n, RequestPool &requests) {
+    return time_on_net(shape, n, requests, [](BenchNet &net) { net.reduce_redundant_edges(); });
+  }
+
+  Measurement run_resolve_unresolved(const Shape &shape, size_t n, RequestPool &requests) {
+    return time_on_net(shape, n, requests, [](BenchNet &net) { net.resolve_unresolved(); });
+  }
+
+  Measurement run_takeover(const Shape &shape, size_t n, RequestPool &requests) {
+    BenchNet other;
+    shape.build(other, n, requests);
+    size_t elements = other.num_elements();
+
+    Measurement m = time_on_net(shape, n, requests, [&other](BenchNet &net) {
+      net.takeover(move(other));
+    });
+    m.elements = elements; // the elements taken over
+    return m;
+  }
+
+  Measurement run_format_dot(const Shape &shape, size_t n, RequestPool &requests) {
+    return time_format<formats::DotGraph>(shape, n, requests);
+  }
+
+  Measurement run_format_plain(const Shape &shape, size_t n, RequestPool &requests) {
+    return time_format<formats::PlainText>(shape, n, requests);
+  }
+
+  struct Operation {
+    const char *name;
+    RunFnTy run;
+  };
+
+  const Operation operations[] = {
+    {"collapse", run_collapse},
+    {"reduce_parallel_paths", run_reduce_parallel_paths},
+    {"reduce_redundant_edges", run_reduce_redundant_edges},
+    {"resolve_unresolved", run_resolve_unresolved},
+    {"takeover", run_takeover},
+    {"format_dot", run_format_dot},
+    {"format_plain", run_format_plain},
+  };
+
+  // -------------------------------------------------------------------------- //
+  // complexity fits
+
+  struct Complexity {
+    const char *name;
+    double (*fn)(double);
+  };
+
+  const Complexity complexities[] = {
+    {"O(N)", [](double n) { return n; }},
+    {"O(N log N)", [](double n) { return n * std::log2(n); }},
+    {"O(N^2)", [](double n) { return n * n; }},
+    {"O(N^3)", [](double n) { return n * n * n; }},
+  };
+
+  struct Fit {
+    const Complexity *complexity = nullptr;
+    double coefficient = 0.0;
+    double rms = std::numeric_limits<double>::infinity(); // relative to the mean time
+  };
+
+  // NOTE: the least squares fit of `time = coefficient * f(N)` for each of
+  //       the complexities, the one with the smallest relative RMS is chosen.
+  Fit fit_complexity(const std::vector<Measurement> &measurements) {
+    Fit best;
+    if (measurements.size() < 2) {
+      return best;
+    }
+
+    double mean_time = 0.0;
+    for (const Measurement &m : measurements) {
+      mean_time += m.time_ns;
+    }
+    mean_time /= measurements.size();
+    if (mean_time <= 0.0) {
+      return best;
+    }
+
+    for (const Complexity &c : complexities) {
+      double tf = 0.0, ff = 0.0;
+      for (const Measurement &m : measurements) {
+        double f = c.fn(m.elements);
+        tf += m.time_ns * f;
+        ff += f * f;
+      }
+      double coefficient = tf / ff;
+
+      double err = 0.0;
+      for (const Measurement &m : measurements) {
+        double diff = m.time_ns - coefficient * c.fn(m.elements);
+        err += diff * diff;
+      }
+      double rms = std::sqrt(err / measurements.size()) / mean_time;
+
+      if (rms < best.rms) {
+        best = {&c, coefficient, rms};
+      }
+    }
+    return best;
+  }
+
+  // -------------------------------------------------------------------------- //
+  // utilities
+
+  template <typename T, size_t N>
+  std::vector<const T *> select(const T (&all)[N], const cl::list<std::string> &names) {
+    std::vector<const T *> selected;
+    for (const T &item : all) {
+      if (names.empty() || is_contained(names, item.name)) {
+        selected.push_back(&item);
+      }
+    }
+    return selected;
+  }
+
+  Measurement measure(const Operation &op, const Shape &shape, size_t n, RequestPool &requests) {
+    Measurement best = op.run(shape, n, requests);
+    for (unsigned r = 1; r < repetitions_arg; r++) {
+      Measurement m = op.run(shape, n, requests);
+      best.time_ns = std::min(best.time_ns, m.time_ns);
+    }
+    return best;
+  }
+
+} // end anonymous namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Microbenchmarks of CommunicationNet algorithms\n");
+
+  // NOTE: the sizes are doubled, hence they have to start above zero
+  if (min_size_arg == 0) {
+    errs() << "The -min-size has to be positive.\n";
+    return 1;
+  }
+
+  std::vector<const Shape *> selected_shapes = select(shapes, shapes_arg);
+  std::vector<const Operation *> selected_ops = select(operations, ops_arg);
+  if (selected_shapes.empty() || selected_ops.empty()) {
+    errs() << "No shape or algorithm selected.\n";
+    return 1;
+  }
+
+  RequestPool requests;
+
+  struct Summary {
+    const Shape *shape;
+    const Operation *op;
+    Fit fit;
+  };
+  std::vector<Summary> summary;
+
+  for (const Operation *op : selected_ops) {
+    for (const Shape *shape : selected_shapes) {
+      outs() << op->name << " on " << shape->name << "\n";
+      outs() << "      size   elements      time [us]   [ns/element]\n";
+
+      std::vector<Measurement> measurements;
+      for (size_t n = min_size_arg; n <= max_size_arg; n *= 2) {
+        Measurement m = measure(*op, *shape, n, requests);
+        outs() << format("  %8zu %10zu %14.1f %14.2f\n",
+                         m.size, m.elements, m.time_ns / 1000.0,
+                         m.time_ns / std::max<size_t>(m.elements, 1));
+        measurements.push_back(m);
+      }
+
+      Fit fit = fit_complexity(measurements);
+      if (fit.complexity) {
+        outs() << format("  fit: %s, coefficient %.3g ns, rms %.0f%%\n",
+                         fit.complexity->name, fit.coefficient, fit.rms * 100.0);
+      }
+      outs() << "\n";
+      summary.push_back({shape, op, fit});
+    }
+  }
+
+  // NOTE: anything worse than O(N log N) is marked
+  outs() << "Summary\n";
+  for (const Summary &s : summary) {
+    const char *name = s.fit.complexity ? s.fit.complexity->name : "-";
+    bool superlinear = s.fit.complexity && s.fit.complexity > &complexities[1];
+    outs() << format("  %-24s %-10s %-12s%s\n", s.op->name, s.shape->name, name,
+                     superlinear ? " !" : "");
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import click
+
+from generate_mpi_program import generate_program
+
+MORPHEUS_PY = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "morpheus.py")
+
+
+# -------------------------------------------------------------------------- #
+# measurements
+
+def run_pipeline(source, nproc, jobs, work_dir):
+    """ Runs the whole pipeline (compilation and generation of the MP nets
+        of all ranks) and returns its wall time, the maximal RSS of its
+        processes and the summary of phases (see -morpheus-time-trace). """
+    trace = os.path.join(work_dir, "trace.json")
+    cmd = [
+        sys.executable, MORPHEUS_PY, source,
+        "-np", str(nproc),
+        "-j", str(jobs),
+        "-o", os.path.join(work_dir, "nets"),
+        "--time-trace", trace,
+        "--memory-stats",
+    ]
+    os.makedirs(os.path.join(work_dir, "nets"), exist_ok=True)
+
+    start = time.monotonic()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = proc.stderr.read()
+    # NOTE: the resource usage of the process includes the children it has
+    #       waited for (clang, opt), ru_maxrss is the maximum among them
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall_time = time.monotonic() - start
+
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        lines = stderr.decode(errors="replace").strip().splitlines()
+        raise RuntimeError(lines[-1] if lines else "exit status {}".format(status))
+
+    with open(trace + ".summary.json") as f:
+        phases = json.load(f)
+    return wall_time, usage.ru_maxrss * 1024, phases
+
+def scaling_exponent(sizes, values):
+    """ The exponent k of the fit `value = c * size^k` (least squares in log-log). """
+    points = [(math.log(s), math.log(v)) for s, v in zip(sizes, values) if v > 0]
+    if len(points) < 2:
+        return None
+    mx = sum(x for x, _ in points) / len(points)
+    my = sum(y for _, y in points) / len(points)
+    sxx = sum((x - mx) ** 2 for x, _ in points)
+    if sxx == 0:
+        return None
+    return sum((x - mx) * (y - my) for x, y in points) / sxx
+
+
+# -------------------------------------------------------------------------- #
+# report
+
+def print_curve(title, sizes, rows, fmt):
+    """ Prints a row per phase with a value per size and the scaling exponent. """
+    print(title)
+    print("  {:<24}".format("phase") + "".join("{:>12}".format(s) for s in sizes) + "{:>8}".format("k"))
+    for name, values in rows:
+        k = scaling_exponent(sizes, values)
+        print("  {:<24}".format(name)
+              + "".join("{:>12}".format(fmt(v)) for v in values)
+              + "{:>8}".format("-" if k is None else "{:.2f}".format(k)))
+    print()
+
+@click.command()
+@click.option("--sizes", default="100,1000,10000", help="Comma separated numbers of MPI call sites.")
+@click.option("-np", "--nproc", default=2, help="Number of processes.")
+@click.option("-j", "--jobs", default=1, help="Number of ranks generated in parallel.")
+@click.option("--call-depth", default=0, help="Depth of call chains of the generated programs.")
+@click.option("--seed", default=0, help="Seed of the program generator.")
+@click.option("--json-output", default=None, type=str, help="Store the measurements into the JSON file.")
+def morpheus_e2e_bench(sizes, nproc, jobs, call_depth, seed, json_output):
+    """ Generates synthetic MPI programs of growing sizes, runs the whole
+        pipeline on them and reports the time and memory of each phase
+        together with the exponent k of its scaling (time ~ size^k). """
+    sizes = [int(s) for s in sizes.split(",")]
+
+    results = []
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for size in sizes:
+            # NOTE: the structure grows together with the number of call sites
+            source, call_sites = generate_program(
+                call_sites=size,
+                branches=max(1, size // 20),
+                loops=max(1, size // 20),
+                request_arrays=max(1, size // 50),
+                call_depth=call_depth,
+                calls=size // 20 if call_depth > 0 else 0,
+                basic_blocks=size,
+                seed=seed,
+            )
+
+            work_dir = os.path.join(tmp_dir, str(size))
+            os.makedirs(work_dir)
+            source_file = os.path.join(work_dir, "stress.cpp")
+            with open(source_file, "w") as f:
+                f.write(source)
+
+            print("size {}: {} MPI call sites ... ".format(size, call_sites), end="", flush=True)
+            try:
+                wall_time, max_rss, phases = run_pipeline(source_file, nproc, jobs, work_dir)
+            except RuntimeError as e:
+                print("failed: {}".format(e))
+                break
+            print("{:.2f}s, {:.1f} MiB".format(wall_time, max_rss / 2**20))
+            results.append({
+                "size": size,
+                "call_sites": call_sites,
+                "wall_time_s": wall_time,
+                "max_rss_bytes": max_rss,
+                "phases": phases,
+            })
+    print()
+
+    if not results:
+        sys.exit(1)
+
+    measured = [r["size"] for r in results]
+    names = sorted({name for r in results for name in r["phases"]})
+    phase = lambda r, name: r["phases"].get(name, {})
+
+    time_rows = [("(total wall time)", [r["wall_time_s"] * 1e6 for r in results])]
+    time_rows += [(name, [phase(r, name).get("total_us", 0) for r in results]) for name in names]
+    print_curve("time [ms]", measured, time_rows, lambda us: "{:.1f}".format(us / 1000))
+
+    mem_rows = [("(max RSS)", [r["max_rss_bytes"] for r in results])]
+    mem_rows += [
+        (name, [phase(r, name).get("counters", {}).get("mem_peak_bytes", 0) for r in results])
+        for name in names
+    ]
+    print_curve("memory [KiB] (peak of accounted memory per phase)", measured, mem_rows, lambda b: "{:.0f}".format(b / 1024))
+
+    if json_output is not None:
+        with open(json_output, "w") as f:
+            json.dump(results, f, indent=2)
+
+if __name__ == "__main__":
+    morpheus_e2e_bench()
@@ -0,0 +1,158 @@
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import click
+
+CORPUS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "examples", "perf-corpus")
+
+# NOTE: each metric has a relative tolerance and an absolute slack, so short
+#       runs do not fail because of the noise of measurements
+METRICS = ("wall_time_s", "max_rss_bytes", "net_nodes", "net_edges")
+
+# NOTE: the exit code of a skipped run (see SKIP_RETURN_CODE in bench/CMakeLists.txt)
+SKIP_RETURN_CODE = 77
+
+
+# -------------------------------------------------------------------------- #
+# measurements
+
+def net_size(output_dir):
+    """ Counts nodes (places and transitions) and edges of all the MP nets. """
+    nodes = edges = 0
+    for name in os.listdir(output_dir):
+        if not name.endswith(".dot"):
+            continue
+        with open(os.path.join(output_dir, name)) as f:
+            for line in f:
+                if "[shape=plain" in line:
+                    nodes += 1
+                elif ":box:c -> " in line:
+                    edges += 1
+    return nodes, edges
+
+def measure(morpheus, source, nproc, work_dir):
+    """ Runs the native driver and returns its wall time, peak RSS and the size of the nets. """
+    output_dir = os.path.join(work_dir, "np{}".format(nproc))
+    os.makedirs(output_dir, exist_ok=True)
+
+    start = time.monotonic()
+    proc = subprocess.Popen([morpheus, source, "-np", str(nproc), "-o", output_dir],
+                            stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = proc.stderr.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall_time = time.monotonic() - start
+
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        lines = stderr.decode(errors="replace").strip().splitlines()
+        raise RuntimeError(lines[-1] if lines else "exit status {}".format(status))
+
+    nodes, edges = net_size(output_dir)
+    return {
+        "wall_time_s": wall_time,
+        "max_rss_bytes": usage.ru_maxrss * 1024,
+        "net_nodes": nodes,
+        "net_edges": edges,
+    }
+
+
+# -------------------------------------------------------------------------- #
+# runner
+
+@click.command()
+@click.option("--morpheus", required=True, type=str, help="Path to the native morpheus driver.")
+@click.option("--corpus", default=CORPUS_DIR, type=str, help="Directory with the programs of the corpus.")
+@click.option("--baseline", default=None, type=str, help="Baseline file (<corpus>/baseline.json by default).")
+@click.option("-np", "--nproc", default=[2, 4], multiple=True, help="Number of processes (can be repeated).")
+@click.option("--repetitions", default=3, help="Number of runs of each program, the fastest one is taken.")
+@click.option("--time-tolerance", default=0.5, help="Allowed relative increase of wall time.")
+@click.option("--rss-tolerance", default=0.2, help="Allowed relative increase of peak RSS.")
+@click.option("--size-tolerance", default=0.0, help="Allowed relative increase of the size of nets.")
+@click.option("--update-baseline", is_flag=True, help="Store the measurements as a new baseline.")
+def morpheus_perf_corpus(morpheus, corpus, baseline, nproc, repetitions,
+                         time_tolerance, rss_tolerance, size_tolerance, update_baseline):
+    """ Runs Morpheus on each (program, np) of the corpus and compares the wall
+        time, peak RSS and the size of the generated nets with the baseline.
+        Fails if any of them regresses beyond its tolerance, or if the baseline
+        lacks any of them (unless the baseline is being updated). Without any
+        baseline, the run is skipped as there is nothing to compare with. """
+    if baseline is None:
+        baseline = os.path.join(corpus, "baseline.json")
+
+    expected = {}
+    if os.path.isfile(baseline):
+        with open(baseline) as f:
+            expected = json.load(f)
+    elif not update_baseline:
+        print("no baseline {}, skipped (record it by --update-baseline)".format(baseline))
+        sys.exit(SKIP_RETURN_CODE)
+
+    # relative tolerance and absolute slack of each metric
+    limits = {
+        "wall_time_s": (time_tolerance, 0.05),
+        "max_rss_bytes": (rss_tolerance, 4 * 2**20),
+        "net_nodes": (size_tolerance, 0),
+        "net_edges": (size_tolerance, 0),
+    }
+
+    programs = sorted(f for f in os.listdir(corpus) if f.endswith(".cpp"))
+    measured = {}
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for program in programs:
+            for np in nproc:
+                key = "{} np={}".format(program, np)
+                work_dir = os.path.join(tmp_dir, os.path.splitext(program)[0])
+
+                try:
+                    runs = [measure(morpheus, os.path.join(corpus, program), np, work_dir)
+                            for _ in range(max(1, repetitions))]
+                except RuntimeError as e:
+                    failures.append("{}: failed: {}".format(key, e))
+                    print("{:<32} FAILED".format(key))
+                    continue
+
+                result = dict(runs[0])
+                result["wall_time_s"] = min(r["wall_time_s"] for r in runs)
+                result["max_rss_bytes"] = min(r["max_rss_bytes"] for r in runs)
+                measured[key] = result
+
+                print("{:<32} {:8.3f}s {:8.1f} MiB {:6} nodes {:6} edges".format(
+                    key, result["wall_time_s"], result["max_rss_bytes"] / 2**20,
+                    result["net_nodes"], result["net_edges"]))
+
+                # NOTE: an incomplete baseline would silently guard nothing
+                if key not in expected:
+                    if not update_baseline:
+                        failures.append("{}: no baseline (record it by --update-baseline)".format(key))
+                    continue
+
+                for metric in METRICS:
+                    base = expected[key].get(metric)
+                    if base is None:
+                        continue
+                    tolerance, slack = limits[metric]
+                    limit = base * (1 + tolerance) + slack
+                    if result[metric] > limit:
+                        failures.append("{}: {} regressed from {} to {} (limit {:.6g})".format(
+                            key, metric, base, result[metric], limit))
+
+    if update_baseline:
+        expected.update(measured)
+        with open(baseline, "w") as f:
+            json.dump(expected, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("baseline updated: {}".format(baseline))
+
+    if failures:
+        print("regressions:")
+        for failure in failures:
+            print("  {}".format(failure))
+        sys.exit(1)
+
+if __name__ == "__main__":
+    morpheus_perf_corpus()
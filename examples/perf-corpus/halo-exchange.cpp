@@ -0,0 +1,50 @@
+#include "mpi.h"
+
+// 1D domain decomposition of a Jacobi iteration, the boundary cells
+// are exchanged with both neighbours in each iteration.
+
+#define N 1024
+#define ITERATIONS 100
+
+int main (int argc, char *argv[]) {
+  enum { TAG_LEFT, TAG_RIGHT };
+
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int left = rank - 1;
+  int right = rank + 1;
+
+  double u[N + 2], v[N + 2];
+  for (int i = 0; i < N + 2; i++) {
+    u[i] = rank;
+  }
+
+  for (int it = 0; it < ITERATIONS; it++) {
+    MPI_Request requests[4];
+    int count = 0;
+
+    if (left >= 0) {
+      MPI_Irecv(&u[0], 1, MPI_DOUBLE, left, TAG_RIGHT, MPI_COMM_WORLD, &requests[count++]);
+      MPI_Isend(&u[1], 1, MPI_DOUBLE, left, TAG_LEFT, MPI_COMM_WORLD, &requests[count++]);
+    }
+    if (right < size) {
+      MPI_Irecv(&u[N + 1], 1, MPI_DOUBLE, right, TAG_LEFT, MPI_COMM_WORLD, &requests[count++]);
+      MPI_Isend(&u[N], 1, MPI_DOUBLE, right, TAG_RIGHT, MPI_COMM_WORLD, &requests[count++]);
+    }
+    MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+
+    for (int i = 1; i <= N; i++) {
+      v[i] = (u[i - 1] + u[i + 1]) / 2;
+    }
+    for (int i = 1; i <= N; i++) {
+      u[i] = v[i];
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include "mpi.h"
+
+// Rank 0 hands out tasks to the workers and collects their results,
+// a worker stops when it receives a task with the stop tag.
+
+#define TASKS 64
+
+int main (int argc, char *argv[]) {
+  enum { TAG_TASK, TAG_RESULT, TAG_STOP };
+
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (rank == 0) {
+    int next = 0, sum = 0;
+
+    // initial distribution
+    for (int worker = 1; worker < size; worker++) {
+      int tag = next < TASKS ? TAG_TASK : TAG_STOP;
+      MPI_Send(&next, 1, MPI_INT, worker, tag, MPI_COMM_WORLD);
+      next++;
+    }
+
+    // a new task for each result
+    for (int done = 0; done < TASKS; done++) {
+      int result;
+      MPI_Status status;
+      MPI_Recv(&result, 1, MPI_INT, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &status);
+      sum += result;
+
+      int tag = next < TASKS ? TAG_TASK : TAG_STOP;
+      MPI_Send(&next, 1, MPI_INT, status.MPI_SOURCE, tag, MPI_COMM_WORLD);
+      next++;
+    }
+  } else {
+    while (true) {
+      int task;
+      MPI_Status status;
+      MPI_Recv(&task, 1, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+      if (status.MPI_TAG == TAG_STOP) {
+        break;
+      }
+
+      int result = task * task;
+      MPI_Send(&result, 1, MPI_INT, 0, TAG_RESULT, MPI_COMM_WORLD);
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
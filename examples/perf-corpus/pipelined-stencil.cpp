@@ -0,0 +1,45 @@
+#include "mpi.h"
+
+// A wavefront (pipelined) sweep of a 2D stencil, the rows are split among
+// the ranks and the columns are processed in blocks. A rank waits for the
+// boundary of a block from its predecessor and passes its own boundary on.
+
+#define ROWS 256
+#define COLS 1024
+#define BLOCK 64
+
+int main (int argc, char *argv[]) {
+  enum { TAG_BOUNDARY };
+
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  static double grid[ROWS + 1][COLS];
+
+  for (int block = 0; block < COLS; block += BLOCK) {
+    if (rank > 0) {
+      MPI_Recv(&grid[0][block], BLOCK, MPI_DOUBLE, rank - 1, TAG_BOUNDARY,
+               MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+
+    for (int i = 1; i <= ROWS; i++) {
+      for (int j = block; j < block + BLOCK; j++) {
+        double west = j > 0 ? grid[i][j - 1] : 0.0;
+        grid[i][j] = (grid[i - 1][j] + west) / 2;
+      }
+    }
+
+    if (rank < size - 1) {
+      MPI_Request request;
+      MPI_Isend(&grid[ROWS][block], BLOCK, MPI_DOUBLE, rank + 1, TAG_BOUNDARY,
+                MPI_COMM_WORLD, &request);
+      MPI_Wait(&request, MPI_STATUS_IGNORE);
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include "mpi.h"
+
+// A token travels several times around the ring of all the ranks.
+
+#define ROUNDS 10
+
+int main (int argc, char *argv[]) {
+  enum { TAG_TOKEN };
+
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int prev = (rank + size - 1) % size;
+  int next = (rank + 1) % size;
+
+  int token = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    if (rank == 0) {
+      token++;
+      MPI_Send(&token, 1, MPI_INT, next, TAG_TOKEN, MPI_COMM_WORLD);
+      MPI_Recv(&token, 1, MPI_INT, prev, TAG_TOKEN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    } else {
+      MPI_Recv(&token, 1, MPI_INT, prev, TAG_TOKEN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      token++;
+      MPI_Send(&token, 1, MPI_INT, next, TAG_TOKEN, MPI_COMM_WORLD);
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,32 @@
+#include "mpi.h"
+
+// Binomial tree reduction implemented by point-to-point messages,
+// the sum ends up at rank 0.
+
+int main (int argc, char *argv[]) {
+  enum { TAG_PARTIAL };
+
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int sum = rank;
+  for (int step = 1; step < size; step *= 2) {
+    if (rank % (2 * step) == 0) {
+      int src = rank + step;
+      if (src < size) {
+        int partial;
+        MPI_Recv(&partial, 1, MPI_INT, src, TAG_PARTIAL, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        sum += partial;
+      }
+    } else {
+      MPI_Send(&sum, 1, MPI_INT, rank - step, TAG_PARTIAL, MPI_COMM_WORLD);
+      break;
+    }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
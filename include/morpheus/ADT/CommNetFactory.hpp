@@ -7,6 +7,7 @@
 
 #include "morpheus/Utils.hpp"
 #include "morpheus/ADT/CommunicationNet.hpp"
+#include "morpheus/Analysis/MPICallKind.hpp"
 
 #include <functional>
 
@@ -37,6 +38,37 @@ struct EmptyCN final : public PluginCNBase {
 };
 
 
+// ------------------------------------------------------------------------------
+// CN_Call
+
+// NOTE: a call of an MPI-involved function is represented by a substitution
+//       transition referring to the summary net of the function (a subnet
+//       of AddressableCN), hence the summary is not built for each call.
+struct CN_Call final : public PluginCNBase {
+
+  ~CN_Call() = default;
+
+  CN_Call(const CallSite &cs, string subnet)
+    : call_name(cs.getCalledFunction()->getName()),
+      call(add_transition(ConditionList(), "call " + call_name)) {
+    entry_place().name += call_name;
+    exit_place().name += call_name;
+    call.subnet = subnet;
+    add_cf_edge(entry_place(), call);
+    add_cf_edge(call, exit_place());
+  }
+  CN_Call(const CN_Call &) = delete;
+  CN_Call(CN_Call &&) = default;
+
+  void connect(AddressableCN &) {
+    // the summary net is connected only once
+  }
+
+  string call_name;
+  Transition &call;
+};
+
+
 // ------------------------------------------------------------------------------
 // CN_MPI_Isend
 
@@ -490,26 +522,25 @@ private:
 // ===========================================================================
 // CNs factory
 
-PluginCNGeneric createCommSubnet(const CallSite &cs) {
-  Function *f = cs.getCalledFunction();
-  assert (f->hasName() && "The CNFactory expects call site with a named function");
-
-  StringRef call_name = f->getName();
-  if (call_name == "MPI_Isend") {
-    return CN_MPI_Isend(cs);
-  } else if (call_name == "MPI_Send") {
-    return CN_MPI_Send(cs);
-  } else if (call_name == "MPI_Irecv") {
-    return CN_MPI_Irecv(cs);
-  } else if (call_name == "MPI_Recv") {
-    return CN_MPI_Recv(cs);
-  } else if (call_name == "MPI_Wait") {
-    return CN_MPI_Wait(cs);
-  } else if (call_name == "MPI_Waitall") {
-    return CN_MPI_Waitall(cs);
+PluginCNGeneric createCommSubnet(const CallSite &cs, MPICallKind kind) {
+  assert (kind == get_mpi_call_kind(cs.getCalledFunction()) &&
+          "The CNFactory expects the kind of the called function");
+
+  switch (kind) {
+  case MPICallKind::ISEND:   return CN_MPI_Isend(cs);
+  case MPICallKind::SEND:    return CN_MPI_Send(cs);
+  case MPICallKind::IRECV:   return CN_MPI_Irecv(cs);
+  case MPICallKind::RECV:    return CN_MPI_Recv(cs);
+  case MPICallKind::WAIT:    return CN_MPI_Wait(cs);
+  case MPICallKind::WAITALL: return CN_MPI_Waitall(cs);
+  default:                   return EmptyCN(cs);
   }
-  return EmptyCN(cs);
 }
 
+PluginCNGeneric createCallSubnet(const CallSite &cs, const string &subnet) {
+  return CN_Call(cs, subnet);
+}
+
+
 } // end of anonymous namespace
 #endif // COMM_NET_FACTORY_H
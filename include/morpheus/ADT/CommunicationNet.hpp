@@ -9,13 +9,20 @@
 #define MRPH_COMM_NET_H
 
 #include "llvm/ADT/BreadthFirstIterator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/CFG.h"
 
 #include "morpheus/Utils.hpp"
+#include "morpheus/Analysis/LoopAnalyses.hpp"
 #include "morpheus/Formats/Formatter.hpp"
+#include "morpheus/Support/MemoryAccounting.hpp"
 
 #include <algorithm>
 #include <map>
@@ -75,6 +82,11 @@ struct Identifiable {
     return id;
   }
 
+  // NOTE: the IDs are unique within the thread since the last reset,
+  //       hence a net built by a single thread after the reset gets the
+  //       same IDs regardless of the nets built concurrently.
+  static void reset_ids();
+
 private:
   static ID generate_id();
 
@@ -104,7 +116,8 @@ struct NetElement : public Identifiable, public Printable<NetElement> {
 };
 
 
-struct Edge final : public Identifiable, public Printable<Edge> {
+struct Edge final : public Identifiable, public Printable<Edge>,
+                    public Accounted<MemoryAccounting::EDGES> {
 
   explicit Edge(NetElement &startpoint, NetElement &endpoint, string arc_expr,
                 EdgeCategory category, EdgeType type)
@@ -150,7 +163,7 @@ private:
 };
 
 
-struct Place final : NetElement {
+struct Place final : NetElement, Accounted<MemoryAccounting::PLACES> {
 
   explicit Place(string name, string type, string init_expr)
     : NetElement(name), type(type), init_expr(init_expr) { }
@@ -170,7 +183,7 @@ struct Place final : NetElement {
 
 using ConditionList = vector<string>;
 
-struct Transition final : NetElement {
+struct Transition final : NetElement, Accounted<MemoryAccounting::TRANSITIONS> {
 
   explicit Transition(string name, const ConditionList guard)
     : NetElement(name), guard(guard) { }
@@ -183,6 +196,9 @@ struct Transition final : NetElement {
   }
 
   ConditionList guard;
+  // NOTE: a substitution transition refers to a subnet of AddressableCN
+  //       (a summary net of a called function), empty otherwise
+  string subnet;
 };
 
 
@@ -213,7 +229,7 @@ private:
   AddressableCN *acn_;
 };
 
-struct UnresolvedPlace final {
+struct UnresolvedPlace final : Accounted<MemoryAccounting::UNRESOLVED_ELEMENTS> {
 
   using ResolveFnTy = function<void(CommunicationNet &cn, Place &, Transition &, UnresolvedConnect &)>;
 
@@ -230,7 +246,7 @@ struct UnresolvedPlace final {
   ResolveFnTy resolve;
 };
 
-struct UnresolvedTransition final {
+struct UnresolvedTransition final : Accounted<MemoryAccounting::UNRESOLVED_ELEMENTS> {
 
   UnresolvedTransition(Transition &transition, const Value &mpi_rqst)
     : transition(transition),
@@ -478,18 +494,21 @@ protected:
   void reduce_parallel_paths() {
     EdgePredicate<CONTROL_FLOW> is_cf;
 
-    // put both places and transitions into one (NetElement*) vector
-    vector<const NetElement*> elements;
-    transform(places_.begin(), places_.end(), back_inserter(elements),
-              [] (const Element<Place> &place) { return place.get(); });
-    transform(transitions_.begin(), transitions_.end(), back_inserter(elements),
-              [] (const Element<Transition> &transition) { return transition.get(); });
-
     // find and remove paths
 
     // NOTE: maybe it would help to topologically sort the nodes,
     //       but it is rather minor performance improvement.
     while (true) {
+      // put both places and transitions into one (NetElement*) vector
+      // NOTE: it is collected again in each iteration as removing a path
+      //       removes also its inner elements
+      vector<const NetElement*> elements;
+      elements.reserve(places_.size() + transitions_.size());
+      transform(places_.begin(), places_.end(), back_inserter(elements),
+                [] (const Element<Place> &place) { return place.get(); });
+      transform(transitions_.begin(), transitions_.end(), back_inserter(elements),
+                [] (const Element<Transition> &transition) { return transition.get(); });
+
       path_t to_remove;
       vector<path_t> found_paths = find_parallel_paths(elements);
       for (path_t &p : found_paths) {
@@ -686,6 +705,15 @@ public:
   }
 
   virtual void resolve_unresolved();
+
+  // NOTE: a request may be initiated in a function and completed in its caller
+  //       (or vice versa), e.g. when MPI_Irecv is wrapped. The unresolved
+  //       elements without a counterpart in the net whose request is mapped
+  //       by `pass` onto a request of the outer net are copied into it.
+  using PassRequestFnTy = function<Value const *(const Value &mpi_rqst)>;
+  void pass_unresolved(CommunicationNet &outer_cn, PassRequestFnTy pass) const;
+  void remove_passed_unresolved(PassRequestFnTy pass);
+
   virtual void collapse();
   virtual void takeover(CommunicationNet cn);
 
@@ -742,6 +770,31 @@ public:
     return add_(make_element_<UnresolvedTransition>(transition, mpi_rqst), unresolved_transitions_);
   }
 
+  // -------------------------------------------------------
+  // size of the net
+
+  virtual size_t num_places() const {
+    return places_.size();
+  }
+
+  virtual size_t num_transitions() const {
+    return transitions_.size();
+  }
+
+  virtual size_t num_edges() const {
+    size_t count = 0;
+    for (const Element<Place> &p : places_) {
+      count += p->leads_to.size();
+    }
+    for (const Element<Transition> &t : transitions_) {
+      count += t->leads_to.size();
+    }
+    return count;
+  }
+
+  // estimates the storage owned by the elements (strings, vectors)
+  virtual void account_memory(MemoryAccounting::Snapshot &snapshot) const;
+
   // -------------------------------------------------------
   // iterators
 
@@ -779,6 +832,9 @@ public:
   }
 
 private:
+  bool is_passed_place(const UnresolvedPlace &, PassRequestFnTy &) const;
+  bool is_passed_transition(const UnresolvedTransition &, PassRequestFnTy &) const;
+
   template <typename T>
   inline T& add_(Element<T> &&e, Elements<T> &elements) {
     elements.push_back(forward<Element<T>>(e));
@@ -841,6 +897,9 @@ struct AddressableCN final : public CommunicationNet {
   Place &crr;
   // inner communication net used to keep away ACN elements from those of plugged nets
   CommunicationNet embedded_cn;
+  // summary nets of functions referred to by substitution transitions, each
+  // one is stored once regardless of the number of its calls
+  map<string, CommunicationNet> subnets;
 
   ~AddressableCN() = default;
 
@@ -873,6 +932,18 @@ struct AddressableCN final : public CommunicationNet {
     //       therefore the reduction of redundant edges is called separately.
     reduce_redundant_edges(collect_all_edges());
     embedded_cn.collapse();
+    for (auto &subnet : subnets) {
+      subnet.second.collapse();
+    }
+  }
+
+  void resolve_unresolved () override {
+    // NOTE: the requests passed between functions are already moved into the nets
+    //       of callers (see `pass_unresolved`), hence each net is resolved separately
+    embedded_cn.resolve_unresolved();
+    for (auto &subnet : subnets) {
+      subnet.second.resolve_unresolved();
+    }
   }
 
   void takeover (CommunicationNet cn) override {
@@ -882,6 +953,47 @@ struct AddressableCN final : public CommunicationNet {
   void clear () override {
     CommunicationNet::clear();
     embedded_cn.clear();
+    subnets.clear();
+  }
+
+  size_t num_places () const override {
+    size_t count = CommunicationNet::num_places() + embedded_cn.num_places();
+    for (const auto &subnet : subnets) {
+      count += subnet.second.num_places();
+    }
+    return count;
+  }
+
+  size_t num_transitions () const override {
+    size_t count = CommunicationNet::num_transitions() + embedded_cn.num_transitions();
+    for (const auto &subnet : subnets) {
+      count += subnet.second.num_transitions();
+    }
+    return count;
+  }
+
+  size_t num_edges () const override {
+    size_t count = CommunicationNet::num_edges() + embedded_cn.num_edges();
+    for (const auto &subnet : subnets) {
+      count += subnet.second.num_edges();
+    }
+    return count;
+  }
+
+  void account_memory (MemoryAccounting::Snapshot &snapshot) const override {
+    CommunicationNet::account_memory(snapshot);
+    embedded_cn.account_memory(snapshot);
+    for (const auto &subnet : subnets) {
+      subnet.second.account_memory(snapshot);
+    }
+  }
+
+  bool has_subnet(const string &name) const {
+    return subnets.count(name) > 0;
+  }
+
+  CommunicationNet &add_subnet(const string &name) {
+    return subnets[name];
   }
 
   // NOTE: the accessing methods are present in order to be able
@@ -1158,6 +1270,12 @@ struct BasicBlockCN final : public PluginCNBase {
     plug_in_(acn);
   }
 
+  // NOTE: moves the elements into a subnet of ACN, the connection to
+  //       the ACN has to be done separately
+  void move_into(CommunicationNet &cn) && {
+    plug_in_(cn);
+  }
+
   // NOTE: As the BasicBlockCN is only an envelope for inner CNs
   //       it needs to keep them separate. Therefore these are added only,
   //       and not injected directly.
@@ -1199,17 +1317,29 @@ struct CFG_CN final : public PluginCNBase {
 
   const Function &fn;
   const LoopInfo &loop_info;
+  ScalarEvolution *se;
   vector<BasicBlockCN> bb_cns;
 
   ~CFG_CN() = default;
 
-  CFG_CN(const Function &fn, LoopInfo &loop_info) : fn(fn), loop_info(loop_info) {
+  // NOTE: when ScalarEvolution is given, the loop headers are annotated
+  //       by their bounds and the iterations of loops with a constant
+  //       number of them are counted (see expose_loops).
+  //       When a slice is given (see MPISlice), only its blocks are
+  //       materialized and the paths through the other ones are collapsed
+  //       into single CF edges.
+  CFG_CN(const Function &fn, LoopInfo &loop_info, ScalarEvolution *se=nullptr,
+         const DenseSet<BasicBlock const *> *slice=nullptr)
+    : fn(fn), loop_info(loop_info), se(se) {
 
     // create the basic structure
-    auto bfs_it = breadth_first(&fn);
-    transform(bfs_it.begin(), bfs_it.end(),
-              back_inserter(bb_cns),
-              [] (const BasicBlock *bb) { return cn::BasicBlockCN(bb); });
+    for (const BasicBlock *bb : breadth_first(&fn)) {
+      if (!slice || slice->count(bb)) {
+        bb_cns.push_back(cn::BasicBlockCN(bb));
+      }
+    }
+
+    create_loop_counters();
 
     interconnect_basicblock_cns();
 
@@ -1242,21 +1372,35 @@ struct CFG_CN final : public PluginCNBase {
     pcn.takeover(move(*this));
   }
 
+  // NOTE: a summary net of a function is not a part of the control flow of
+  //       the ACN, it is kept in the given subnet and entered only through
+  //       substitution transitions
+  void inject_into_subnet(AddressableCN &acn, CommunicationNet &subnet) && {
+    connect(acn);
+
+    for (BasicBlockCN &bbcn : bb_cns) {
+      move(bbcn).move_into(subnet);
+    }
+
+    subnet.takeover(move(*this));
+  }
+
 private:
+  struct LoopCounter {
+    Place *entry;  // entered from outside of the loop
+    Place *counter;
+    string iterations;
+  };
+  DenseMap<Loop const *, LoopCounter> loop_counters;
   void interconnect_basicblock_cns() {
-    // TODO: think about a bit more optimal solution
+    DenseMap<BasicBlock const *, BasicBlockCN *> bbcn_of;
+    for (BasicBlockCN &bbcn : bb_cns) {
+      bbcn_of[bbcn.bb] = &bbcn;
+    }
 
     for (BasicBlockCN &bbcn : bb_cns) {
-      const BasicBlock *bb = bbcn.bb;
-
-      for (const BasicBlock *pred_bb : predecessors(bb)) {
-        std::for_each(bb_cns.begin(),
-                      bb_cns.end(),
-                      [pred_bb, &bbcn] (BasicBlockCN &bbcn_) {
-                        if (pred_bb == bbcn_.bb) {
-                          bbcn_.add_cf_edge(bbcn_.exit_place(), bbcn.entry_place());
-                        }
-                      });
+      for (BasicBlock const *succ_bb : get_successors(bbcn.bb, bbcn_of)) {
+        bbcn.add_cf_edge(bbcn.exit_place(), get_entry_from(bbcn.bb, *bbcn_of[succ_bb]));
       }
     }
 
@@ -1268,6 +1412,30 @@ private:
     }
   }
 
+  // the successors of the block among the materialized ones, the paths through
+  // the blocks out of the slice are followed until a materialized one is met
+  SmallVector<BasicBlock const *, 4> get_successors(
+      BasicBlock const *bb,
+      const DenseMap<BasicBlock const *, BasicBlockCN *> &bbcn_of) const {
+
+    SmallVector<BasicBlock const *, 4> found;
+    SmallPtrSet<BasicBlock const *, 8> visited;
+    SmallVector<BasicBlock const *, 8> worklist(succ_begin(bb), succ_end(bb));
+
+    for (size_t idx = 0; idx < worklist.size(); idx++) {
+      BasicBlock const *succ_bb = worklist[idx];
+      if (!visited.insert(succ_bb).second) {
+        continue;
+      }
+      if (bbcn_of.count(succ_bb)) {
+        found.push_back(succ_bb);
+      } else {
+        worklist.append(succ_begin(succ_bb), succ_end(succ_bb));
+      }
+    }
+    return found;
+  }
+
   BasicBlockCN& get_entry_bb() {
     // as the basic blocks are stored in bfs manner, the first one is the entry one.
     BasicBlockCN& entry_bb = bb_cns.front();
@@ -1300,7 +1468,19 @@ private:
     return exit_bbs;
   }
 
-  void update_loop_branch(BasicBlock &loop_branch, string trigger_input_expr) {
+  // the loops with a counter are entered through the transition setting
+  // the counter, the back edges lead directly to the header
+  Place& get_entry_from(BasicBlock const *bb, BasicBlockCN &succ_bbcn) {
+    Loop *loop = loop_info.getLoopFor(succ_bbcn.bb);
+    auto counter_it = loop_counters.find(loop);
+    if (counter_it != loop_counters.end() &&
+        loop->getHeader() == succ_bbcn.bb && !loop->contains(bb)) {
+      return *counter_it->second.entry;
+    }
+    return succ_bbcn.entry_place();
+  }
+
+  Transition& update_loop_branch(BasicBlock &loop_branch, string trigger_input_expr) {
     auto found_bbcn_it = find_if(
       bb_cns.begin(), bb_cns.end(),
       [&loop_branch] (const BasicBlockCN &bbcn) { return &loop_branch == bbcn.bb; });
@@ -1326,12 +1506,47 @@ private:
     Place &new_entry = bbcn.add_place("Unit", "", entry_name);
     bbcn.add_cf_edge(trigger_branch, new_entry);
     bbcn.set_entry(new_entry);
+
+    return trigger_branch;
+  }
+
+  // NOTE: the counter of a loop is an Int place set to 0 by the transition
+  //       entering the loop. It is restricted to the loops with a constant
+  //       number of taken back edges, a single exit, and a latch distinct
+  //       from the header, i.e. the loops whose branches are both exposed.
+  void create_loop_counters() {
+    if (!se) {
+      return;
+    }
+    for (BasicBlockCN &bbcn : bb_cns) {
+      Loop *loop = loop_info.getLoopFor(bbcn.bb);
+      if (!loop || loop->getHeader() != bbcn.bb || !loop->getExitBlock() ||
+          !loop->getLoopLatch() || loop->getLoopLatch() == bbcn.bb) {
+        continue;
+      }
+      Optional<uint64_t> iterations = get_loop_iterations(*se, *loop);
+      if (!iterations) {
+        continue;
+      }
+
+      Place &counter = bbcn.add_place("Int", "", "loop_counter " + bbcn.get_id());
+      Place &entry = bbcn.add_place("Unit", "", "enter_loop " + bbcn.get_id());
+      Transition &set_counter = bbcn.add_transition(ConditionList());
+      bbcn.add_cf_edge(entry, set_counter);
+      bbcn.add_cf_edge(set_counter, bbcn.entry_place());
+      bbcn.add_output_edge(set_counter, counter, "0");
+
+      loop_counters[loop] = {&entry, &counter, std::to_string(*iterations)};
+    }
   }
 
   void expose_loops() {
     // NOTE: expose the loops in a way that loop header
     //       is represented by a Boolean place, and each
-    //       branch is triggered by a transition
+    //       branch is triggered by a transition.
+    //       The known bounds of the loop are annotated, and
+    //       the loops with a counter take the body while
+    //       it < N and exit when it == N (N taken back edges).
     for (BasicBlockCN &bbcn : bb_cns) {
       auto *loop = loop_info.getLoopFor(bbcn.bb);
       if (loop && loop->getHeader() == bbcn.bb) {
@@ -1341,17 +1556,32 @@ private:
         Place &exit_p = bbcn.exit_place();
         exit_p.type = "Bool";
         exit_p.name = "test_loop " + bbcn.get_id();
+        if (se) {
+          exit_p.compound_label = get_loop_bounds(*se, *loop);
+        }
+
+        auto counter_it = loop_counters.find(loop);
+        LoopCounter *counter = counter_it != loop_counters.end() ? &counter_it->second : nullptr;
 
         // Body of the loop
         auto *loop_latch = loop->getLoopLatch();
         if (loop_latch) {
-          update_loop_branch(*loop_latch, "true");
+          Transition &next = update_loop_branch(*loop_latch, "true");
+          if (counter) {
+            next.guard.push_back("it < " + counter->iterations);
+            bbcn.add_input_edge(*counter->counter, next, "it");
+            bbcn.add_output_edge(next, *counter->counter, "it + 1");
+          }
         }
 
         // Exit branch of the loop
         auto *loop_exit = loop->getExitBlock();
         if (loop_exit) {
-          update_loop_branch(*loop_exit, "false");
+          Transition &leave = update_loop_branch(*loop_exit, "false");
+          if (counter) {
+            leave.guard.push_back("it == " + counter->iterations);
+            bbcn.add_input_edge(*counter->counter, leave, "it");
+          }
         }
       }
     }
@@ -1,4 +1,3 @@
-
 //===----------------------------------------------------------------------===//
 //
 // ParentPointerNode
@@ -8,51 +7,144 @@
 #ifndef MRPH_PPNODE_H
 #define MRPH_PPNODE_H
 
-#include <memory>
-#include <optional>
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
 
 #include "llvm/Support/raw_ostream.h"
 
+// NOTE: the nodes of parent-pointer trees are allocated within an arena and
+//       refer to their parents by indices, the arena can hold a forest.
 template<typename T>
-class PPNode {
+class PPNodeArena {
+public:
+  using NodeId = unsigned;
+  static constexpr NodeId NONE = std::numeric_limits<NodeId>::max();
 
-  unsigned depth;
-  std::shared_ptr<PPNode<T>> parent;
+  struct PPNode {
+    T data;
+    NodeId parent;
+    unsigned depth;
+  };
 
-public:
-  T data;
+  PPNodeArena() = default;
+  PPNodeArena(const PPNodeArena &arena) = default;
+  PPNodeArena(PPNodeArena &&arena) = default;
+  PPNodeArena &operator=(PPNodeArena &&arena) = default;
+
+  NodeId create(const T &data) {
+    return add({data, NONE, 0});
+  }
+
+  NodeId create(const T &data, NodeId parent) {
+    assert(parent < nodes.size() && "Unknown parent.");
+    return add({data, parent, nodes[parent].depth + 1});
+  }
 
-  static std::shared_ptr<PPNode<T>> create(const T &data) {
-    return std::make_shared<PPNode<T>>(data);
+  const PPNode &operator[](NodeId id) const {
+    return nodes[id];
   }
 
-  explicit PPNode(const T &data) : depth(0), data(data) { }
-  PPNode(PPNode &&node) = default;
-  PPNode() = delete;
-  PPNode(const PPNode &node) = delete;
+  NodeId get_parent(NodeId id) const {
+    return nodes[id].parent;
+  }
 
-  void set_parent(const std::shared_ptr<PPNode<T>> &parent) {
-    this->parent = parent;
-    depth = parent->depth + 1;
+  unsigned get_depth(NodeId id) const {
+    return nodes[id].depth;
   }
 
-  std::shared_ptr<PPNode<T>> get_parent() const {
-    return parent;
+  size_t size() const {
+    return nodes.size();
   }
 
-  unsigned get_depth() const {
-    return depth;
+  // the lowest common ancestor of the nodes, NONE if they are in different trees
+  NodeId get_common_ancestor(NodeId a, NodeId b) const {
+    build_jumps();
+
+    if (nodes[a].depth < nodes[b].depth) {
+      std::swap(a, b);
+    }
+
+    // equalize the depth levels
+    unsigned diff = nodes[a].depth - nodes[b].depth;
+    for (unsigned k = 0; diff; k++, diff >>= 1) {
+      if (diff & 1) {
+        a = jumps[k][a];
+      }
+    }
+    if (a == b) {
+      return a;
+    }
+
+    // jump to the highest ancestors that are still different
+    for (unsigned k = jumps.size(); k-- > 0; ) {
+      if (jumps[k][a] != jumps[k][b]) {
+        a = jumps[k][a];
+        b = jumps[k][b];
+      }
+    }
+    return nodes[a].parent == nodes[b].parent ? nodes[a].parent : NONE;
   }
+
+  size_t get_memory_size() const {
+    size_t bytes = nodes.capacity() * sizeof(PPNode);
+    for (const std::vector<NodeId> &level : jumps) {
+      bytes += level.capacity() * sizeof(NodeId);
+    }
+    return bytes;
+  }
+
+private:
+  NodeId add(PPNode &&node) {
+    jumps.clear(); // the jumps are rebuilt on the next query
+    nodes.push_back(std::move(node));
+    return nodes.size() - 1;
+  }
+
+  // binary lifting: jumps[k][n] is the 2^k-th ancestor of the node n
+  // NOTE: a parent is always created before its children, hence the levels
+  //       are filled in the order of nodes.
+  void build_jumps() const {
+    if (!jumps.empty() || nodes.empty()) {
+      return;
+    }
+
+    unsigned max_depth = 0;
+    for (const PPNode &node : nodes) {
+      max_depth = std::max(max_depth, node.depth);
+    }
+
+    unsigned levels = 1;
+    while ((1u << levels) <= max_depth) {
+      levels++;
+    }
+
+    jumps.assign(levels, std::vector<NodeId>(nodes.size(), NONE));
+    for (NodeId id = 0; id < nodes.size(); id++) {
+      jumps[0][id] = nodes[id].parent;
+    }
+    for (unsigned k = 1; k < levels; k++) {
+      for (NodeId id = 0; id < nodes.size(); id++) {
+        NodeId half = jumps[k - 1][id];
+        jumps[k][id] = (half == NONE) ? NONE : jumps[k - 1][half];
+      }
+    }
+  }
+
+  std::vector<PPNode> nodes;
+  mutable std::vector<std::vector<NodeId>> jumps;
 };
 
 namespace llvm {
   template<typename T>
-  raw_ostream &operator<< (raw_ostream &out, const PPNode<T> &node) {
-    out << "Node(" << node.data << ")";
-    if (node.get_parent()) {
-      out << " -> " << *node.get_parent();
+  void print_track(raw_ostream &out, const PPNodeArena<T> &arena,
+                   typename PPNodeArena<T>::NodeId id) {
+    out << "Node(" << arena[id].data << ")";
+    if (arena.get_parent(id) != PPNodeArena<T>::NONE) {
+      out << " -> ";
+      print_track(out, arena, arena.get_parent(id));
     }
-    return out;
   }
 }
 
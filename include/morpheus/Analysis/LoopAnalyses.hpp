@@ -0,0 +1,92 @@
+//===----------------------------------------------------------------------===//
+//
+// LoopAnalyses
+//
+// The analyses of loops of a single function computed outside of a pass
+// manager, and the bounds of loops as annotated within the MP nets.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_LOOP_ANALYSES_H
+#define MRPH_LOOP_ANALYSES_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include <string>
+
+namespace llvm {
+
+  struct LoopAnalyses {
+    DominatorTree dt;
+    LoopInfo loop_info;
+    TargetLibraryInfoImpl tlii;
+    TargetLibraryInfo tli;
+    AssumptionCache ac;
+    ScalarEvolution se;
+
+    explicit LoopAnalyses(Function &fn)
+      : dt(fn), loop_info(dt),
+        tlii(Triple(fn.getParent()->getTargetTriple())), tli(tlii),
+        ac(fn), se(fn, tli, ac, dt, loop_info) { }
+  };
+
+  // the number of taken back edges if it is a constant
+  inline Optional<uint64_t> get_loop_iterations(ScalarEvolution &se, const Loop &loop) {
+    const SCEV *backedges = se.getBackedgeTakenCount(&loop);
+    if (const SCEVConstant *count = dyn_cast<SCEVConstant>(backedges)) {
+      return count->getAPInt().getLimitedValue();
+    }
+    return None;
+  }
+
+  // NOTE: the annotation of a loop header in the MP net, i.e. the number of
+  //       taken back edges (the iterations that return to the header) and
+  //       the induction variable. Only the constant ones are annotated, the
+  //       symbolic ones refer to IR values that do not exist in the net.
+  //       An empty string if nothing is known.
+  inline std::string get_loop_bounds(ScalarEvolution &se, const Loop &loop) {
+    std::string bounds;
+
+    if (Optional<uint64_t> iterations = get_loop_iterations(se, loop)) {
+      bounds = std::to_string(*iterations) + " iterations";
+    } else {
+      const SCEV *max_backedges = se.getMaxBackedgeTakenCount(&loop);
+      if (const SCEVConstant *max_count = dyn_cast<SCEVConstant>(max_backedges)) {
+        bounds = "at most " + std::to_string(max_count->getAPInt().getLimitedValue()) + " iterations";
+      }
+    }
+
+    // the first named affine recurrence of the header with constant start and step
+    for (const PHINode &phi : loop.getHeader()->phis()) {
+      if (!phi.hasName() || !se.isSCEVable(phi.getType())) {
+        continue;
+      }
+      auto *rec = dyn_cast<SCEVAddRecExpr>(se.getSCEV(const_cast<PHINode *>(&phi)));
+      if (!rec || rec->getLoop() != &loop || !rec->isAffine()) {
+        continue;
+      }
+      auto *start = dyn_cast<SCEVConstant>(rec->getStart());
+      auto *step = dyn_cast<SCEVConstant>(rec->getStepRecurrence(se));
+      if (start && step && start->getAPInt().getMinSignedBits() <= 64
+          && step->getAPInt().getMinSignedBits() <= 64) {
+        bounds += std::string(bounds.empty() ? "" : "; ") + phi.getName().str()
+                  + " from " + std::to_string(start->getAPInt().getSExtValue())
+                  + " step " + std::to_string(step->getAPInt().getSExtValue());
+        break;
+      }
+    }
+    return bounds;
+  }
+
+} // end llvm
+
+#endif // MRPH_LOOP_ANALYSES_H
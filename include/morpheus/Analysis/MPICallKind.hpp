@@ -0,0 +1,92 @@
+
+//===----------------------------------------------------------------------===//
+//
+// MPICallKind
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_MPI_CALL_KIND_H
+#define MRPH_MPI_CALL_KIND_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+// NOTE: the MPI functions known to Morpheus, the other functions with 'MPI_'
+//       prefix are OTHER, the non-MPI functions are NONE.
+enum struct MPICallKind : unsigned char {
+  INIT,
+  FINALIZE,
+  COMM_RANK,
+  COMM_SIZE,
+  SEND,
+  ISEND,
+  RECV,
+  IRECV,
+  WAIT,
+  WAITALL,
+  OTHER,
+  NONE,
+};
+
+constexpr unsigned NUM_MPI_CALL_KINDS = static_cast<unsigned>(MPICallKind::NONE) + 1;
+
+// NOTE: StringSwitch dispatches on the length of the name first, hence
+//       a name is compared with at most a couple of candidates.
+inline MPICallKind get_mpi_call_kind(llvm::StringRef name) {
+  if (!name.startswith("MPI_")) {
+    return MPICallKind::NONE;
+  }
+  return llvm::StringSwitch<MPICallKind>(name)
+    .Case("MPI_Init",      MPICallKind::INIT)
+    .Case("MPI_Finalize",  MPICallKind::FINALIZE)
+    .Case("MPI_Comm_rank", MPICallKind::COMM_RANK)
+    .Case("MPI_Comm_size", MPICallKind::COMM_SIZE)
+    .Case("MPI_Send",      MPICallKind::SEND)
+    .Case("MPI_Isend",     MPICallKind::ISEND)
+    .Case("MPI_Recv",      MPICallKind::RECV)
+    .Case("MPI_Irecv",     MPICallKind::IRECV)
+    .Case("MPI_Wait",      MPICallKind::WAIT)
+    .Case("MPI_Waitall",   MPICallKind::WAITALL)
+    .Default(MPICallKind::OTHER);
+}
+
+inline MPICallKind get_mpi_call_kind(llvm::Function const *f) {
+  if (!f || !f->hasName()) {
+    return MPICallKind::NONE;
+  }
+  return get_mpi_call_kind(f->getName());
+}
+
+inline bool is_mpi_call_kind(MPICallKind kind) {
+  return kind != MPICallKind::NONE;
+}
+
+// NOTE: MPI_COMM_WORLD is a constant handle in MPICH and a global object
+//       in Open MPI. The other communicators are created at runtime, hence
+//       their sizes are not known.
+inline bool is_comm_world(const llvm::Value *comm) {
+  comm = comm->stripPointerCasts();
+  if (auto *handle = llvm::dyn_cast<llvm::ConstantInt>(comm)) {
+    return handle->getValue() == 0x44000000;
+  }
+  if (auto *object = llvm::dyn_cast<llvm::GlobalValue>(comm)) {
+    return object->getName() == "ompi_mpi_comm_world";
+  }
+  return false;
+}
+
+// NOTE: a cheap pre-scan of declarations, the modules without any MPI
+//       function are not analyzed further
+inline bool declares_mpi_functions(const llvm::Module &m) {
+  for (const llvm::Function &f : m) {
+    if (f.hasName() && f.getName().startswith("MPI_")) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif // MRPH_MPI_CALL_KIND_H
@@ -9,14 +9,21 @@
 #define MRPH_MPI_LABELLING_H
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator_range.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 
 #include "llvm/Support/raw_ostream.h"
 
+#include "morpheus/Analysis/MPICallKind.hpp"
+#include "morpheus/Support/MemoryAccounting.hpp"
+
+#include <array>
+#include <utility>
 #include <vector>
-#include <queue>
 
 enum struct MPICallType {
   DIRECT,
@@ -28,11 +35,25 @@ namespace llvm {
 
   class MPILabelling {
   public:
-    using MPICheckpoints = std::queue<std::pair<const CallSite, MPICallType>>;
+    struct MPICall {
+      CallSite cs;
+      MPICallKind kind;
+      BasicBlock const *bb;
+      Function const *fn;
+    };
+    using MPICallRange = iterator_range<std::vector<MPICall>::const_iterator>;
+
+    struct MPICheckpoint {
+      CallSite cs;
+      MPICallType type;
+      MPICallKind kind; // NONE for the indirect checkpoints
+    };
+    using MPICheckpoints = std::vector<MPICheckpoint>;
+    using MPICheckpointRange = iterator_range<MPICheckpoints::const_iterator>;
 
   private:
     enum ExplorationState {
-      PROCESSING = 0,
+      PROCESSING = 0,              // a call within the SCC being labelled
       SEQUENTIAL,                  // 'sequential' < 'external' because unless proved otherwise
                                    // the function is supposed to be sequential.
       EXTERNAL,                    // indirect call cannot be analyzed what is inside
@@ -42,29 +63,65 @@ namespace llvm {
     };
 
     using FunctionLabels = DenseMap<Function const *, ExplorationState>;
-    using MPICalls = DenseMap<StringRef, std::vector<CallSite>>;
-    using MPICheckpointsInBB = DenseMap<BasicBlock const *, MPICheckpoints>;
+    using MPIFunctionKinds = DenseMap<Function const *, MPICallKind>;
+    // NOTE: the calls are grouped by their kinds, the calls of a kind are
+    //       stored in the program order within mpi_calls[kind_offsets[kind],
+    //       kind_offsets[kind + 1])
+    using MPICalls = std::vector<MPICall>;
+    using MPICallKindOffsets = std::array<unsigned, NUM_MPI_CALL_KINDS + 1>;
+    // NOTE: the checkpoints are stored in one array sorted by (basic block,
+    //       position of the call within the block), each block refers to
+    //       the range [first, second) of its checkpoints
+    using MPICheckpointsInBB = DenseMap<BasicBlock const *, std::pair<unsigned, unsigned>>;
+
+    // NOTE: the functions without callers within the module, 'main' first
+    std::vector<CallGraphNode *> roots;
 
     FunctionLabels fn_labels;
+    MPIFunctionKinds fn_kinds;
     MPICalls mpi_calls;
+    MPICallKindOffsets kind_offsets;
+    MPICheckpoints mpi_checkpoints;
     MPICheckpointsInBB bb_mpi_checkpoints;
 
   public:
 
+    // NOTE: only the functions reachable from the roots are labelled.
     explicit MPILabelling(CallGraph &cg);
+    // NOTE: transfers the labelling of an original module onto its clone.
+    //       Calls that do not survive in the clone are dropped, and the roots
+    //       are not transferred as they refer to the call graph.
+    MPILabelling(const MPILabelling &labelling, const ValueToValueMapTy &vmap);
     MPILabelling(const MPILabelling &labelling) = default;
     MPILabelling(MPILabelling &&labelling) = default;
 
-    Instruction *get_unique_call(StringRef name) const;
-    std::vector<Instruction *> get_calls(StringRef name) const;
+    Instruction *get_unique_call(MPICallKind kind) const;
+    std::vector<Instruction *> get_calls(MPICallKind kind) const;
+    MPICallRange get_mpi_calls(MPICallKind kind) const;
+    const std::vector<CallGraphNode *> &get_roots() const;
     bool is_sequential(Function const *f) const;
     bool is_mpi_involved(Function const *f) const;
-    MPICheckpoints get_mpi_checkpoints(BasicBlock const *bb) const;
+    // the checkpoints of the block in the order of instructions
+    MPICheckpointRange get_mpi_checkpoints(BasicBlock const *bb) const;
+
+    // estimates the storage of the maps
+    void account_memory(MemoryAccounting::Snapshot &snapshot) const;
 
   private:
 
-    ExplorationState explore_cgnode(CallGraphNode const *cgn);
-    void save_checkpoint(CallSite cs, MPICallType call_type);
+    // collects the calls of MPI functions in a single scan of the module
+    void index_calls(Module &m);
+    void sort_calls_by_kind(MPICalls &&calls);
+    void find_roots(CallGraph &cg);
+
+    // NOTE: the SCCs are labelled bottom-up, i.e., all the callees outside
+    //       of the given SCC are expected to be labelled already.
+    void label_scc(const std::vector<CallGraphNode const *> &scc);
+    ExplorationState get_callee_state(CallGraphNode const *callee,
+                                      const SmallPtrSetImpl<CallGraphNode const *> &scc,
+                                      bool scc_involved) const;
+    void save_checkpoint(CallSite cs, MPICallType call_type, MPICallKind kind);
+    void sort_checkpoints();
 
     template<ExplorationState STATE> bool check_status(Function const *f) const {
       auto search = fn_labels.find(f);
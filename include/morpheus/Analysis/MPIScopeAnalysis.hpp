@@ -13,30 +13,31 @@
 
 #include "morpheus/ADT/ParentPointerNode.hpp"
 #include "morpheus/Analysis/MPILabellingAnalysis.hpp"
+#include "morpheus/Support/MemoryAccounting.hpp"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/ilist_iterator.h"
 #include "llvm/ADT/simple_ilist.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Function.h"
-#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 
 #include <optional>
-#include <unordered_map>
 #include <iterator>
 
 namespace llvm {
 
   class MPIScope {
-    using VisitedNodes = std::unordered_map<CallGraphNode const *, bool>;
-
   public:
     using CallNodeDataT = std::pair<std::optional<Instruction *>, Function *>;
-    using CallNode = PPNode<CallNodeDataT>;
-    using CallsTrack = std::shared_ptr<CallNode>;
+    using CallNodes = PPNodeArena<CallNodeDataT>;
+    using CallsTrack = CallNodes::NodeId;
 
     ~MPIScope() = default;
 
-    explicit MPIScope(ModuleSummaryIndex &index, MPILabelling &labelling, CallGraph &cg);
+    explicit MPIScope(MPILabelling &labelling);
+    // NOTE: transfers the scope of an original module onto its clone.
+    MPIScope(const MPIScope &scope, const ValueToValueMapTy &vmap);
     MPIScope(const MPIScope &scope) = delete;
     MPIScope(MPIScope &&scope) = default;
 
@@ -44,12 +45,23 @@ namespace llvm {
     Function *getFunction();
     LoopInfo *getLoopInfo();
 
+    // estimates the storage of call tracks
+    void account_memory(MemoryAccounting::Snapshot &snapshot) const;
+
   private:
-    void process_cgnode(CallGraphNode const *cgn, const CallsTrack &track, VisitedNodes &visited);
+    void process_root(CallGraphNode const *root);
+    // NOTE: the track of a call is materialized on the first query
+    CallsTrack get_calls_track(Instruction *inst);
 
     Function *scope_fn;
     LoopInfo loop_info;
-    std::unordered_map<Instruction const *, CallsTrack> instruction_calls_track;
+
+    // NOTE: a function is tracked by the first path (in the order of roots
+    //       and call records) that reaches it, the tracks of its calls
+    //       continue from this node.
+    CallNodes call_nodes;
+    DenseMap<Function const *, CallsTrack> function_tracks;
+    DenseMap<Instruction const *, CallsTrack> instruction_calls_track;
 
     friend raw_ostream &operator<< (raw_ostream &out, const CallNodeDataT &data);
   }; // MPIScope
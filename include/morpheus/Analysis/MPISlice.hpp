@@ -0,0 +1,60 @@
+//===----------------------------------------------------------------------===//
+//
+// MPISlice
+//
+// The basic blocks of a function that matter for its communication: blocks
+// with MPI checkpoints, their control dependences, the branches selecting
+// the values of MPI arguments, the loop structure around them and the entry
+// and exit blocks. The other blocks are collapsed into control flow edges
+// between the blocks of the slice.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_MPI_SLICE_H
+#define MRPH_MPI_SLICE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+
+#include "morpheus/Analysis/MPILabellingAnalysis.hpp"
+
+namespace llvm {
+
+  class MPISlice {
+  public:
+    MPISlice(const Function &fn, const LoopInfo &loop_info, const MPILabelling &labelling);
+
+    bool contains(BasicBlock const *bb) const {
+      return blocks.count(bb);
+    }
+
+    size_t size() const {
+      return blocks.size();
+    }
+
+    const DenseSet<BasicBlock const *> &get_blocks() const {
+      return blocks;
+    }
+
+  private:
+    void compute_control_dependences(const Function &fn);
+    void add_argument_dependences(const Value *arg);
+    void add_loop_structure(const Loop &loop);
+    void add(BasicBlock const *bb);
+    // closes the slice under control dependences
+    void close();
+
+    DenseSet<BasicBlock const *> blocks;
+    SmallVector<BasicBlock const *, 16> pending;
+
+    // a block -> the branching blocks it is control dependent on
+    DenseMap<BasicBlock const *, SmallVector<BasicBlock const *, 2>> control_dependences;
+  }; // MPISlice
+
+} // end llvm
+
+#endif // MRPH_MPI_SLICE_H
@@ -0,0 +1,65 @@
+//===----------------------------------------------------------------------===//
+//
+// RankPredicates
+//
+// The conditions of branches that guard MPI checkpoints and depend only on
+// the rank (and the size of communicator), e.g. `rank == 0`, `rank % 2`.
+// The outcomes of the predicates partition the ranks into classes whose
+// processes take the same guarded branches.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_RANK_PREDICATES_H
+#define MRPH_RANK_PREDICATES_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "morpheus/Analysis/MPILabellingAnalysis.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class RankPredicates {
+  public:
+    // NOTE: the outcome of each predicate for a rank, a class of ranks
+    //       shares the same outcomes
+    using Outcomes = std::vector<bool>;
+
+    // NOTE: a condition is taken as a predicate only if it can be evaluated
+    //       for each of the ranks (e.g. no division by zero)
+    RankPredicates(const Module &m, const MPILabelling &labelling, unsigned nproc,
+                   ArrayRef<unsigned> ranks);
+
+    // the rank has to be one of those given at the construction
+    Outcomes evaluate(unsigned rank) const;
+
+    // the conjunction of the predicates (negated if false), e.g.: rank == 0 && rank % 2 != 0
+    std::string describe(const Outcomes &outcomes) const;
+
+    // the branches conditioned by the predicates (in the order of outcomes)
+    const std::vector<BranchInst *> &get_branches() const {
+      return branches;
+    }
+
+  private:
+    Optional<int64_t> eval(const Value *v, unsigned rank, unsigned depth=0) const;
+    bool depends_on_rank(const Value *v, unsigned depth=0) const;
+    std::string print(const Value *v) const;
+
+    DenseSet<const Value *> rank_values; // the loads of MPI_Comm_rank outputs
+    DenseSet<const Value *> size_values; // the loads of MPI_Comm_size outputs
+    unsigned nproc;
+
+    std::vector<BranchInst *> branches;
+  }; // RankPredicates
+
+} // end llvm
+
+#endif // MRPH_RANK_PREDICATES_H
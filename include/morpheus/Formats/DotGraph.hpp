@@ -1,6 +1,6 @@
 
-#ifndef MORPH_PLAIN_TEXT_FMT
-#define MORPH_PLAIN_TEXT_FMT
+#ifndef MORPH_DOT_GRAPH_FMT
+#define MORPH_DOT_GRAPH_FMT
 
 #include "morpheus/Formats/Formatter.hpp"
 
@@ -119,11 +119,13 @@ namespace cn {
         if (transition.highlight_color != "none") {
           bgcolor = "bgcolor=\"" + transition.highlight_color + "\"";
         }
+        // substitution transitions are distinguished by a thick border
+        string border = transition.subnet.empty() ? "1" : "3";
         os << transition.get_id()
            << " [shape=plain label=<"
            << "<table border=\"0\">"
             << "<tr>"
-            << "<td border=\"1\" " << bgcolor << " cellpadding=\"10\" port=\"box\">"; format(os, static_cast<const NetElement &>(transition)); os << "</td>"
+            << "<td border=\"" << border << "\" " << bgcolor << " cellpadding=\"10\" port=\"box\">"; format(os, static_cast<const NetElement &>(transition)); os << "</td>"
             << "</tr>"
             << "<tr>"
              << "<td>" << Utils::pp_vector(transition.guard, ", ", "[", "]") << "</td>"
@@ -163,17 +165,32 @@ namespace cn {
         os << "label=\"Address: " << acn.address << " \";\n";
         os << "}\n";
 
-        // print edges from the embedded CN
-        for (auto const &p : acn.embedded_cn.places()) {
-          std::for_each(p->leads_to.begin(),
-                        p->leads_to.end(),
-                        create_print_fn_<Edge>(os, *this, "\n", 0));
+        // format the summary nets of functions
+        for (auto const &subnet : acn.subnets) {
+          os << "subgraph cluster_CN" << subnet.second.get_id() << "{\n";
+          format(os, subnet.second);
+          os << "label=\"Function: " << subnet.first << " \";\n";
+          os << "}\n";
         }
 
-        for (auto const &t : acn.embedded_cn.transitions()) {
-          std::for_each(t->leads_to.begin(),
-                        t->leads_to.end(),
-                        create_print_fn_<Edge>(os, *this, "\n", 0));
+        // print edges from the embedded CN and the summary nets
+        std::vector<const CommunicationNet *> nets = {&acn.embedded_cn};
+        for (auto const &subnet : acn.subnets) {
+          nets.push_back(&subnet.second);
+        }
+
+        for (const CommunicationNet *cn : nets) {
+          for (auto const &p : cn->places()) {
+            std::for_each(p->leads_to.begin(),
+                          p->leads_to.end(),
+                          create_print_fn_<Edge>(os, *this, "\n", 0));
+          }
+
+          for (auto const &t : cn->transitions()) {
+            std::for_each(t->leads_to.begin(),
+                          t->leads_to.end(),
+                          create_print_fn_<Edge>(os, *this, "\n", 0));
+          }
         }
 
         // print the edges of the ACN
@@ -199,4 +216,4 @@ namespace cn {
   }
 } // end of cn namespace
 
-# endif // MORPH_PLAIN_TEXT_FMT
+# endif // MORPH_DOT_GRAPH_FMT
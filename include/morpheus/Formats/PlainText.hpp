@@ -60,6 +60,10 @@ namespace cn {
         format(os, static_cast<const NetElement&>(transition));
 
         os << Utils::pp_vector(transition.guard, ", ", "[", "]");
+
+        if (!transition.subnet.empty()) {
+          os << " => " << transition.subnet;
+        }
         return os;
       }
 
@@ -90,16 +94,24 @@ namespace cn {
                       places.end(),
                       create_print_fn_<Place>(os, *this, "\n", 2));
 
-        // print the embedded communication net
+        // print the embedded communication net and the summary nets of functions
+        std::vector<const CommunicationNet *> nets = {&acn.embedded_cn};
         format(os, acn.embedded_cn);
+        for (const auto &subnet : acn.subnets) {
+          os << "Function " << subnet.first << ": ";
+          format(os, subnet.second);
+          nets.push_back(&subnet.second);
+        }
 
         os << "Input edges:\n";
-        for (const auto &p : acn.embedded_cn.places()) {
-          std::for_each(
-            p->leads_to.begin(),
-            p->leads_to.end(),
-            create_print_fn_<Edge>(
-              os, *this, CommunicationNet::EdgePredicate<REGULAR>(), "\n", 2));
+        for (const CommunicationNet *cn : nets) {
+          for (const auto &p : cn->places()) {
+            std::for_each(
+              p->leads_to.begin(),
+              p->leads_to.end(),
+              create_print_fn_<Edge>(
+                os, *this, CommunicationNet::EdgePredicate<REGULAR>(), "\n", 2));
+          }
         }
         for (const auto &p : acn.places()) {
           std::for_each(
@@ -110,11 +122,13 @@ namespace cn {
         }
 
         os << "Outuput edges:\n";
-        for (const auto &t : acn.embedded_cn.transitions()) {
-          std::for_each(t->leads_to.begin(),
-                        t->leads_to.end(),
-                        create_print_fn_<Edge>(
-                          os, *this, CommunicationNet::EdgePredicate<REGULAR>(), "\n", 2));
+        for (const CommunicationNet *cn : nets) {
+          for (const auto &t : cn->transitions()) {
+            std::for_each(t->leads_to.begin(),
+                          t->leads_to.end(),
+                          create_print_fn_<Edge>(
+                            os, *this, CommunicationNet::EdgePredicate<REGULAR>(), "\n", 2));
+          }
         }
 
         os << "CF edges: \n";
@@ -125,17 +139,19 @@ namespace cn {
             create_print_fn_<Edge>(
               os, *this, CommunicationNet::EdgePredicate<CONTROL_FLOW>(), "\n", 2));
         }
-        for (const auto &p : acn.embedded_cn.places()) {
-          std::for_each(p->leads_to.begin(),
-                        p->leads_to.end(),
-                        create_print_fn_<Edge>(
-                          os, *this, CommunicationNet::EdgePredicate<CONTROL_FLOW>(), "\n", 2));
-        }
-        for (const auto &t : acn.embedded_cn.transitions()) {
-          std::for_each(t->leads_to.begin(),
-                        t->leads_to.end(),
-                        create_print_fn_<Edge>(
-                          os, *this, CommunicationNet::EdgePredicate<CONTROL_FLOW>(), "\n", 2));
+        for (const CommunicationNet *cn : nets) {
+          for (const auto &p : cn->places()) {
+            std::for_each(p->leads_to.begin(),
+                          p->leads_to.end(),
+                          create_print_fn_<Edge>(
+                            os, *this, CommunicationNet::EdgePredicate<CONTROL_FLOW>(), "\n", 2));
+          }
+          for (const auto &t : cn->transitions()) {
+            std::for_each(t->leads_to.begin(),
+                          t->leads_to.end(),
+                          create_print_fn_<Edge>(
+                            os, *this, CommunicationNet::EdgePredicate<CONTROL_FLOW>(), "\n", 2));
+          }
         }
         os << "----------------------------------------\n";
         return os;
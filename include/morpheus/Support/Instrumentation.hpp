@@ -0,0 +1,169 @@
+//===----------------------------------------------------------------------===//
+//
+// Instrumentation
+//
+// Scoped timers of the phases of MP net generation. Each scope records its
+// duration and optional counters (e.g., the size of the net before and after
+// a step). The records are exported as a JSON summary aggregated per phase
+// and as a Chrome trace (chrome://tracing, Perfetto). The instrumentation is
+// disabled by default; a disabled scope does not even read the clock.
+//
+// If the memory accounting is enabled, scopes also report the peak of
+// accounted memory within the phase (see MemoryAccounting).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_INSTRUMENTATION_H
+#define MRPH_INSTRUMENTATION_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "morpheus/Support/MemoryAccounting.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+  class Instrumentation {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Counters = std::vector<std::pair<std::string, int64_t>>;
+
+    struct Event {
+      std::string name;
+      std::string detail;
+      unsigned tid;
+      Clock::time_point start;
+      Clock::duration duration;
+      Counters counters;
+    };
+
+    static Instrumentation &get();
+
+    void enable() { enabled = true; }
+    bool is_enabled() const { return enabled; }
+
+    void add_event(Event event);
+    // drops the recorded events (e.g. once they are written)
+    void clear();
+
+    // aggregated per name: count, total and maximal time, and sums of counters
+    // (except of memory counters, prefixed by `mem_`, where the maximum is kept)
+    void write_summary(raw_ostream &os) const;
+    // events in Chrome trace event format
+    void write_trace(raw_ostream &os) const;
+    // writes the trace into `path` and the summary into `path`.summary.json
+    bool write(StringRef path) const;
+
+    static unsigned get_thread_id();
+
+  private:
+    Instrumentation() : epoch(Clock::now()) { }
+
+    std::atomic<bool> enabled{false};
+    const Clock::time_point epoch;
+
+    mutable std::mutex mtx;
+    std::vector<Event> events;
+  };
+
+  class TimeScope {
+  public:
+    explicit TimeScope(StringRef name, StringRef detail="")
+      : enabled(Instrumentation::get().is_enabled()),
+        accounting(MemoryAccounting::get().is_enabled()) {
+      if (accounting) {
+        event.name = name;
+        saved_peak = MemoryAccounting::get_thread_peak();
+        start_bytes = MemoryAccounting::get_thread_bytes();
+        MemoryAccounting::get_thread_peak() = start_bytes;
+      }
+      if (enabled) {
+        event.name = name;
+        event.detail = detail;
+        event.start = Instrumentation::Clock::now();
+      }
+    }
+
+    TimeScope(const TimeScope &) = delete;
+    TimeScope& operator=(const TimeScope &) = delete;
+
+    ~TimeScope() {
+      stop();
+    }
+
+    // ends the scope before the end of the enclosing block
+    void stop() {
+      if (stopped) {
+        return;
+      }
+      if (accounting) {
+        int64_t &thread_peak = MemoryAccounting::get_thread_peak();
+        int64_t phase_peak = thread_peak - start_bytes;
+        add_counter("mem_peak_bytes", phase_peak);
+        add_counter("mem_delta_bytes", MemoryAccounting::get_thread_bytes() - start_bytes);
+        MemoryAccounting::get().record_phase_peak(event.name, phase_peak);
+        thread_peak = std::max(saved_peak, thread_peak);
+      }
+      stopped = true;
+      if (enabled) {
+        event.duration = Instrumentation::Clock::now() - event.start;
+        event.tid = Instrumentation::get_thread_id();
+        Instrumentation::get().add_event(std::move(event));
+      }
+    }
+
+    bool is_enabled() const { return enabled; }
+
+    void add_counter(StringRef name, int64_t value) {
+      if (enabled && !stopped) {
+        event.counters.emplace_back(name, value);
+      }
+    }
+
+    // NOTE: the net is expected to provide num_places(), num_transitions()
+    //       and num_edges(); the counters are named e.g., `places_before`.
+    template <typename Net>
+    void add_net_counters(StringRef suffix, const Net &net) {
+      if (enabled) {
+        add_counter(("places_" + suffix).str(), net.num_places());
+        add_counter(("transitions_" + suffix).str(), net.num_transitions());
+        add_counter(("edges_" + suffix).str(), net.num_edges());
+      }
+    }
+
+    // NOTE: records an estimate of the storage owned by the object (e.g., a net),
+    //       it is expected to provide account_memory(MemoryAccounting::Snapshot &).
+    template <typename T>
+    void add_memory_counters(const T &obj) {
+      if (accounting) {
+        MemoryAccounting::Snapshot snapshot{};
+        obj.account_memory(snapshot);
+        MemoryAccounting::get().record(snapshot);
+        int64_t bytes = 0;
+        for (const MemoryAccounting::Usage &usage : snapshot) {
+          bytes += usage.bytes;
+        }
+        add_counter("mem_estimated_bytes", bytes);
+      }
+    }
+
+  private:
+    const bool enabled;
+    const bool accounting;
+    bool stopped = false;
+    int64_t saved_peak = 0;
+    int64_t start_bytes = 0;
+    Instrumentation::Event event;
+  };
+} // end llvm
+
+#endif // MRPH_INSTRUMENTATION_H
@@ -0,0 +1,127 @@
+//===----------------------------------------------------------------------===//
+//
+// MemoryAccounting
+//
+// Optional accounting of the memory used by MP net generation. The heap
+// objects of nets (places, transitions, edges, unresolved elements) are
+// accounted exactly when allocated and freed. The storage they own (strings,
+// vectors of edges, guards) and the storage of analyses (call tracks of
+// MPIScope, maps of MPILabelling) is estimated from snapshots taken at the ends
+// of phases. Besides the overall usage, the peak of exactly accounted bytes
+// is tracked per phase (see TimeScope).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_MEMORY_ACCOUNTING_H
+#define MRPH_MEMORY_ACCOUNTING_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+
+namespace llvm {
+
+  class MemoryAccounting {
+  public:
+    enum Category : unsigned {
+      // heap objects (exact)
+      PLACES,
+      TRANSITIONS,
+      EDGES,
+      UNRESOLVED_ELEMENTS,
+      // owned storage (estimated)
+      NET_STRINGS,
+      EDGE_VECTORS,
+      GUARDS,
+      SCOPE_CALL_TRACKS,
+      LABELLING_MAPS,
+      NUM_CATEGORIES
+    };
+
+    struct Usage {
+      int64_t count = 0;
+      int64_t bytes = 0;
+    };
+
+    using Snapshot = std::array<Usage, NUM_CATEGORIES>;
+
+    static MemoryAccounting &get();
+    static StringRef get_name(Category category);
+
+    void enable() { enabled = true; }
+    bool is_enabled() const { return enabled; }
+
+    void allocate(Category category, size_t bytes);
+    void deallocate(Category category, size_t bytes);
+
+    // keeps the maxima of estimated categories
+    void record(const Snapshot &snapshot);
+
+    // peak of exactly accounted bytes within a phase (reported by TimeScope)
+    void record_phase_peak(StringRef phase, int64_t bytes);
+
+    void print_report(raw_ostream &os) const;
+
+    // NOTE: the bytes allocated (and not freed) by the current thread, together
+    //       with their peak, are used to compute the peaks of nested phases.
+    static int64_t &get_thread_bytes();
+    static int64_t &get_thread_peak();
+
+  private:
+    MemoryAccounting() = default;
+
+    struct Counter {
+      std::atomic<int64_t> count{0};
+      std::atomic<int64_t> bytes{0};
+      std::atomic<int64_t> peak_bytes{0};
+      std::atomic<int64_t> allocations{0};
+    };
+
+    std::atomic<bool> enabled{false};
+    std::array<Counter, NUM_CATEGORIES> counters;
+    std::atomic<int64_t> total_bytes{0};
+    std::atomic<int64_t> total_peak_bytes{0};
+
+    mutable std::mutex mtx;
+    std::map<std::string, int64_t> phase_peaks;
+  };
+
+  // Mix-in of heap objects accounted within the given category.
+  template <MemoryAccounting::Category C>
+  struct Accounted {
+    static void *operator new(size_t size) {
+      MemoryAccounting::get().allocate(C, size);
+      return ::operator new(size);
+    }
+
+    static void operator delete(void *ptr, size_t size) {
+      MemoryAccounting::get().deallocate(C, size);
+      ::operator delete(ptr);
+    }
+  };
+
+  // heap storage of a string, zero if it fits into the small string buffer
+  inline size_t get_heap_size(const std::string &str) {
+    static const size_t sso_capacity = std::string().capacity();
+    return str.capacity() > sso_capacity ? str.capacity() + 1 : 0;
+  }
+
+  inline void account_string(MemoryAccounting::Snapshot &snapshot,
+                             MemoryAccounting::Category category,
+                             const std::string &str) {
+    size_t size = get_heap_size(str);
+    if (size > 0) {
+      snapshot[category].count++;
+      snapshot[category].bytes += size;
+    }
+  }
+} // end llvm
+
+#endif // MRPH_MEMORY_ACCOUNTING_H
@@ -0,0 +1,82 @@
+
+//===----------------------------------------------------------------------===//
+//
+// NetCache
+//
+// Content-addressed on-disk cache of generated MP nets. The nets are stored
+// as objects named by the hash of their content, the index maps the keys
+// (hash of the module, rank, number of processes, version of Morpheus and
+// revision of the generated nets)
+// to the objects. The size of objects is bounded, the least recently used
+// ones are evicted first.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_NET_CACHE_H
+#define MRPH_NET_CACHE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class NetCache {
+  public:
+    struct Stats {
+      unsigned hits = 0;
+      unsigned misses = 0;
+      unsigned evictions = 0;
+    };
+
+    // NOTE: it has to be bumped whenever the generated nets change (e.g. the
+    //       modelling or the format), otherwise the stale nets are restored.
+    //       The driver computes the keys as well (see src/netcache.py).
+    static constexpr unsigned NET_REVISION = 2;
+
+    NetCache(std::string cache_dir, uint64_t size_limit);
+    NetCache(const NetCache &) = delete;
+
+    static std::string get_digest(StringRef content);
+    static std::string get_key(StringRef module_digest, unsigned rank, unsigned nproc);
+
+    // Copies the nets of all the keys into the output directory. It returns
+    // true only if all of them are found, otherwise nothing is copied.
+    bool restore(ArrayRef<std::string> keys, StringRef output_dir);
+
+    // Stores the net file under the given key.
+    void store(StringRef key, StringRef net_path);
+
+    // Removes the least recently used objects to fit within the size limit.
+    void evict();
+
+    // Prints the statistics of the current run and the overall ones.
+    void print_stats(raw_ostream &os);
+
+  private:
+    struct Entry {
+      std::string object_path;
+      std::string file_name;
+    };
+
+    bool lookup(StringRef key, Entry &entry) const;
+    std::string get_objects_dir() const;
+    std::string get_index_dir() const;
+    std::string get_object_path(StringRef digest) const;
+    std::string get_index_path(StringRef key) const;
+
+    std::string cache_dir;
+    uint64_t size_limit;
+
+    std::mutex mtx;
+    Stats stats;
+  };
+
+} // end llvm
+
+#endif // MRPH_NET_CACHE_H
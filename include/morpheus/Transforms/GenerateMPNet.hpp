@@ -11,11 +11,33 @@
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/PassManager.h"
 
+#include <memory>
+#include <string>
+
+namespace cn {
+  struct AddressableCN;
+}
+
 namespace llvm {
 
+  class MPIScope;
+  class MPILabelling;
+
   struct GenerateMPNetPass : public PassInfoMixin<GenerateMPNetPass> {
 
     PreservedAnalyses run (Module &m, ModuleAnalysisManager &am);
+
+    // NOTE: the construction of the net is separated from the pass in order
+    //       to be able to run it on already computed (transferred) analyses.
+    static std::unique_ptr<cn::AddressableCN> generate(std::string address,
+                                                       MPIScope &mpi_scope,
+                                                       MPILabelling &mpi_labelling);
+
+    static std::string get_file_name(const Module &m, const cn::AddressableCN &acn);
+
+    // NOTE: the suffix replaces the address when it does not fit into
+    //       a file name (e.g. a predicate of a class of ranks)
+    static std::string get_file_name(const Module &m, const std::string &suffix);
   };
 } // end llvm
 
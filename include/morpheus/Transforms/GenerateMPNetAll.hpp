@@ -0,0 +1,49 @@
+
+//===----------------------------------------------------------------------===//
+//
+// GenerateMPNetAll
+//
+// Generates MP nets for all the ranks within a single run. The module is
+// cloned per rank and the clones reuse the analyses of the original module.
+// The ranks can be processed in parallel by a pool of workers. Optionally,
+// the generated nets are stored into a cache (see NetCache). In the symbolic
+// mode, the rank stays symbolic and a net is generated per class of ranks
+// that share the outcomes of rank predicates (see RankPredicates).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_GENERATE_MPN_ALL_H
+#define MRPH_GENERATE_MPN_ALL_H
+
+#include "llvm/IR/PassManager.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  struct GenerateMPNetAllOptions {
+    unsigned nproc = 1;
+    std::string output_dir = ".";
+    unsigned jobs = 1;
+    std::vector<unsigned> ranks;     // an empty list selects all the ranks
+    std::string cache_dir;           // an empty directory disables the cache
+    uint64_t cache_size_limit = 0;   // in bytes
+    std::string source_digest;       // a key of the module given by the driver (see src/netcache.py),
+                                     // the digest of the bitcode is used if empty
+    bool symbolic_rank = false;      // a net per class of ranks (see RankPredicates)
+  };
+
+  struct GenerateMPNetAllPass : public PassInfoMixin<GenerateMPNetAllPass> {
+
+    explicit GenerateMPNetAllPass(GenerateMPNetAllOptions opts) : opts(opts) { }
+
+    PreservedAnalyses run (Module &m, ModuleAnalysisManager &am);
+
+  private:
+    GenerateMPNetAllOptions opts;
+  };
+} // end llvm
+
+#endif // MRPH_GENERATE_MPN_ALL_H
@@ -8,13 +8,33 @@
 #ifndef MRPH_MPI_SUBSTITUTE_RANK_H
 #define MRPH_MPI_SUBSTITUTE_RANK_H
 
+#include "llvm/IR/Instruction.h"
 #include "llvm/IR/PassManager.h"
 
+#include <optional>
+#include <vector>
+
 namespace llvm {
 
   struct MPISubstituteRankPass : public PassInfoMixin<MPISubstituteRankPass> {
 
+    // NOTE: the size of MPI_COMM_WORLD is substituted only if nproc is given
+    explicit MPISubstituteRankPass(unsigned rank, std::optional<unsigned> nproc=std::nullopt)
+      : rank(rank), nproc(nproc) { }
+
     PreservedAnalyses run (Module &m, ModuleAnalysisManager& am);
+
+    // NOTE: the substitution itself is separated from the pass in order to
+    //       be able to reuse `MPI_Comm_rank` calls found within a different
+    //       (original) module for its clones.
+    static void substitute(Module &m, const std::vector<Instruction *> &comm_ranks, unsigned rank);
+
+    // substitutes the outputs of `MPI_Comm_size` calls by nproc
+    static void substitute_size(Module &m, const std::vector<Instruction *> &comm_sizes, unsigned nproc);
+
+  private:
+    unsigned rank;
+    std::optional<unsigned> nproc;
   };
 } // end llvm
 
@@ -0,0 +1,27 @@
+//===----------------------------------------------------------------------===//
+//
+// MorpheusPrepare
+//
+// The standard passes run around MPISubstituteRankPass. The preparation
+// makes the values SSA before the rank is substituted, the pruning propagates
+// the substituted constants (also through arguments, return values and
+// globals) and removes the blocks unreachable for the rank.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MRPH_MORPHEUS_PREPARE_H
+#define MRPH_MORPHEUS_PREPARE_H
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+  // SROA
+  void add_prepare_passes(ModulePassManager &mpm);
+
+  // SROA, IPSCCP, ADCE and SimplifyCFG
+  void add_prune_passes(ModulePassManager &mpm);
+
+} // end llvm
+
+#endif // MRPH_MORPHEUS_PREPARE_H
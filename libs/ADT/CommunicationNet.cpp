@@ -1,17 +1,28 @@
 
 #include "morpheus/ADT/CommunicationNet.hpp"
 #include "morpheus/Formats/PlainText.hpp"
+#include "morpheus/Support/Instrumentation.hpp"
 
 #include <algorithm>
+#include <set>
 #include <sstream>
 
 namespace cn {
 
   using namespace llvm;
 
+  namespace {
+    // NOTE: the nets of different ranks may be generated concurrently,
+    //       each one by a single thread
+    thread_local unsigned int last_id = 0;
+  }
+
   Identifiable::ID Identifiable::generate_id() {
-    static unsigned int id = 0;
-    return std::to_string(++id);
+    return std::to_string(++last_id);
+  }
+
+  void Identifiable::reset_ids() {
+    last_id = 0;
   }
 
 
@@ -111,20 +122,135 @@ namespace cn {
     }
   }
 
+  // # private
+  // the request is passed if it has no counterpart within the net
+  bool CommunicationNet::is_passed_place(const UnresolvedPlace &up,
+                                         PassRequestFnTy &pass) const {
+    return pass(up.mpi_rqst) &&
+      std::none_of(unresolved_transitions_.begin(), unresolved_transitions_.end(),
+                   [&up](const auto &ut) { return &up.mpi_rqst == &ut->mpi_rqst; });
+  }
+
+  bool CommunicationNet::is_passed_transition(const UnresolvedTransition &ut,
+                                              PassRequestFnTy &pass) const {
+    return pass(ut.mpi_rqst) &&
+      std::none_of(unresolved_places_.begin(), unresolved_places_.end(),
+                   [&ut](const auto &up) { return &up->mpi_rqst == &ut.mpi_rqst; });
+  }
+
+  // + public methods
+  void CommunicationNet::pass_unresolved(CommunicationNet &outer_cn,
+                                         PassRequestFnTy pass) const {
+    for (const auto &up : unresolved_places_) {
+      if (is_passed_place(*up, pass)) {
+        outer_cn.add_unresolved_place(up->place, *pass(up->mpi_rqst), up->resolve);
+      }
+    }
+    for (const auto &ut : unresolved_transitions_) {
+      if (is_passed_transition(*ut, pass)) {
+        UnresolvedTransition &outer_ut =
+          outer_cn.add_unresolved_transition(ut->transition, *pass(ut->mpi_rqst));
+        outer_ut.unresolved_connect = ut->unresolved_connect;
+      }
+    }
+  }
+
+  void CommunicationNet::remove_passed_unresolved(PassRequestFnTy pass) {
+    // NOTE: both kinds are decided before removing any of them,
+    //       as the decision depends on the elements of the other kind
+    std::set<UnresolvedPlace const *> passed_places;
+    std::set<UnresolvedTransition const *> passed_transitions;
+    for (const auto &up : unresolved_places_) {
+      if (is_passed_place(*up, pass)) {
+        passed_places.insert(up.get());
+      }
+    }
+    for (const auto &ut : unresolved_transitions_) {
+      if (is_passed_transition(*ut, pass)) {
+        passed_transitions.insert(ut.get());
+      }
+    }
+
+    unresolved_places_.erase(
+      std::remove_if(unresolved_places_.begin(), unresolved_places_.end(),
+                     [&](const auto &up) { return passed_places.count(up.get()); }),
+      unresolved_places_.end());
+    unresolved_transitions_.erase(
+      std::remove_if(unresolved_transitions_.begin(), unresolved_transitions_.end(),
+                     [&](const auto &ut) { return passed_transitions.count(ut.get()); }),
+      unresolved_transitions_.end());
+  }
+
   void CommunicationNet::collapse() {
     CommunicationNet tmp_cn;
-    collapse_topdown(places_, tmp_cn, &CommunicationNet::places_);
-    collapse_topdown(transitions_, tmp_cn, &CommunicationNet::transitions_);
-    std::swap(tmp_cn, *this);
+    {
+      TimeScope ts("collapse_topdown");
+      ts.add_net_counters("before", *this);
+      collapse_topdown(places_, tmp_cn, &CommunicationNet::places_);
+      collapse_topdown(transitions_, tmp_cn, &CommunicationNet::transitions_);
+      std::swap(tmp_cn, *this);
+      ts.add_net_counters("after", *this);
+    }
 
     tmp_cn.clear();
-    collapse_bottomup(places_, tmp_cn, &CommunicationNet::places_);
-    collapse_bottomup(transitions_, tmp_cn, &CommunicationNet::transitions_);
-    std::swap(tmp_cn, *this);
+    {
+      TimeScope ts("collapse_bottomup");
+      ts.add_net_counters("before", *this);
+      collapse_bottomup(places_, tmp_cn, &CommunicationNet::places_);
+      collapse_bottomup(transitions_, tmp_cn, &CommunicationNet::transitions_);
+      std::swap(tmp_cn, *this);
+      ts.add_net_counters("after", *this);
+    }
+
+    {
+      TimeScope ts("reduce_parallel_paths");
+      ts.add_net_counters("before", *this);
+      reduce_parallel_paths();
+      ts.add_net_counters("after", *this);
+    }
+
+    {
+      TimeScope ts("reduce_redundant_edges");
+      ts.add_net_counters("before", *this);
+      reduce_redundant_edges(collect_all_edges());
+      ts.add_net_counters("after", *this);
+    }
+  }
 
-    reduce_parallel_paths();
+  static void account_element(MemoryAccounting::Snapshot &snapshot, const NetElement &elem) {
+    account_string(snapshot, MemoryAccounting::NET_STRINGS, elem.get_id());
+    account_string(snapshot, MemoryAccounting::NET_STRINGS, elem.name);
+    account_string(snapshot, MemoryAccounting::NET_STRINGS, elem.highlight_color);
 
-    reduce_redundant_edges(collect_all_edges());
+    MemoryAccounting::Usage &vectors = snapshot[MemoryAccounting::EDGE_VECTORS];
+    vectors.count += 2;
+    vectors.bytes += elem.leads_to.capacity() * sizeof(elem.leads_to[0]) +
+                     elem.referenced_by.capacity() * sizeof(elem.referenced_by[0]);
+
+    for (const auto &edge : elem.leads_to) {
+      account_string(snapshot, MemoryAccounting::NET_STRINGS, edge->get_id());
+      account_string(snapshot, MemoryAccounting::NET_STRINGS, edge->arc_expr);
+    }
+  }
+
+  void CommunicationNet::account_memory(MemoryAccounting::Snapshot &snapshot) const {
+    for (const Element<Place> &p : places_) {
+      account_element(snapshot, *p);
+      account_string(snapshot, MemoryAccounting::NET_STRINGS, p->type);
+      account_string(snapshot, MemoryAccounting::NET_STRINGS, p->init_expr);
+      account_string(snapshot, MemoryAccounting::NET_STRINGS, p->compound_label);
+    }
+
+    for (const Element<Transition> &t : transitions_) {
+      account_element(snapshot, *t);
+
+      MemoryAccounting::Usage &guards = snapshot[MemoryAccounting::GUARDS];
+      guards.count++;
+      guards.bytes += t->guard.capacity() * sizeof(string);
+      for (const string &condition : t->guard) {
+        guards.bytes += get_heap_size(condition);
+      }
+    }
   }
 
   void CommunicationNet::takeover(CommunicationNet cn) {
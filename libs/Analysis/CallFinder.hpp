@@ -1,8 +1,10 @@
-
 #ifndef MR_CALLFINDER_H
 #define MR_CALLFINDER_H
 
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/InstVisitor.h"
+
+#include <functional>
 #include <vector>
 
 using namespace llvm;
@@ -17,27 +19,36 @@ public:
       const IRUnitT &unit,
       std::function<bool(const CallInst&)> filter=[](const CallInst&) { return true; }) {
 
-    CallVisitor cv(filter);
+    std::vector<CallInst*> found_insts;
+    for_each_call(unit, [&filter, &found_insts](CallSite cs) {
+      CallInst *inst = dyn_cast<CallInst>(cs.getInstruction());
+      if (inst && filter(*inst)) {
+        found_insts.push_back(inst);
+      }
+    });
+    return found_insts;
+  }
+
+  // visits all the call sites (calls and invokes) of the unit in a single
+  // scan, in the order of functions, basic blocks and instructions
+  static void for_each_call(const IRUnitT &unit, std::function<void(CallSite)> callback) {
+    CallVisitor cv(callback);
     cv.visit(const_cast<IRUnitT &>(unit));
-    return cv.found_insts;
   }
 
 private:
   struct CallVisitor : public InstVisitor<CallVisitor> {
 
-    // a name of call we are searching for
-    std::function<bool(const CallInst&)> filter;
+    std::function<void(CallSite)> callback;
 
-    // a list of call instructions
-    std::vector<CallInst*> found_insts; // TODO: is it safe to store the pointer here?
+    CallVisitor(std::function<void(CallSite)> callback) : callback(callback) { }
 
-    CallVisitor(std::function<bool(const CallInst&)> filter) : filter(filter) { }
-
-    // define visitor function that filters the instructions according to the callee's name
     void visitCallInst(CallInst &inst) {
-      if (filter(inst)) {
-        found_insts.push_back(&inst);
-      }
+      callback(CallSite(&inst));
+    }
+
+    void visitInvokeInst(InvokeInst &inst) {
+      callback(CallSite(&inst));
     }
   };
 };
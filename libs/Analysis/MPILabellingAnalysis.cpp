@@ -1,6 +1,12 @@
 
+#include "llvm/ADT/SCCIterator.h"
+
 #include "morpheus/Analysis/MPILabellingAnalysis.hpp"
+#include "morpheus/Support/Instrumentation.hpp"
+
+#include "CallFinder.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 
@@ -24,48 +30,137 @@ AnalysisKey MPILabellingAnalysis::Key;
 // MPILabelling
 
 MPILabelling::MPILabelling(CallGraph &cg) {
+  TimeScope ts("MPILabelling");
 
-  // There is no root node
-  for (const auto &node : cg) {
-    CallGraphNode const *cgn = node.second.get();
-    if (cgn->getFunction()) { // explore only function node TODO: check whether is it enough to ignore non-function calls or the reaction should be "better"?
-      explore_cgnode(cgn);
+  kind_offsets.fill(0);
+  if (!declares_mpi_functions(cg.getModule())) {
+    return; // nothing to label
+  }
+
+  index_calls(cg.getModule());
+  ts.add_counter("mpi_calls", mpi_calls.size());
+
+  find_roots(cg);
+  ts.add_counter("roots", roots.size());
+
+  // NOTE: a temporary node calling all the roots is the entry of a single
+  //       traversal, hence the functions unreachable from the roots are not
+  //       visited and the shared callees are visited once.
+  CallGraphNode entry(nullptr);
+  for (CallGraphNode *root : roots) {
+    entry.addCalledFunction(CallSite(), root);
+  }
+
+  // NOTE: scc_iterator visits the SCCs in post-order (callees first) without
+  //       recursion, hence each SCC is labelled once its callees are known.
+  size_t num_sccs = 0;
+  const CallGraphNode *const_entry = &entry;
+  for (auto scc_it = scc_begin(const_entry); !scc_it.isAtEnd(); ++scc_it) {
+    label_scc(*scc_it);
+    num_sccs++;
+  }
+  entry.removeAllCalledFunctions();
+
+  sort_checkpoints();
+
+  ts.add_counter("sccs", num_sccs);
+  ts.add_counter("functions", fn_labels.size());
+  ts.add_counter("checkpoints", mpi_checkpoints.size());
+  ts.add_memory_counters(*this);
+}
+
+MPILabelling::MPILabelling(const MPILabelling &labelling, const ValueToValueMapTy &vmap) {
+  TimeScope ts("MPILabelling", "clone");
+  kind_offsets.fill(0);
+
+  // NOTE: the value map keeps weak handles, hence the instructions removed
+  //       from the clone (e.g. within a dead branch of other rank) map to null.
+  auto map_call = [&vmap] (const CallSite &cs) {
+    return CallSite(dyn_cast_or_null<Instruction>(vmap.lookup(cs.getInstruction())));
+  };
+
+  for (const auto &fn_label : labelling.fn_labels) {
+    Function const *f = cast<Function>(vmap.lookup(fn_label.first));
+    fn_labels[f] = fn_label.second;
+  }
+
+  for (const auto &fn_kind : labelling.fn_kinds) {
+    Function const *f = cast<Function>(vmap.lookup(fn_kind.first));
+    fn_kinds[f] = fn_kind.second;
+  }
+
+  // NOTE: the clone keeps the order of instructions, hence the remapped
+  //       calls stay grouped by kinds and in the program order
+  for (const MPICall &call : labelling.mpi_calls) {
+    CallSite mapped_cs = map_call(call.cs);
+    if (mapped_cs) {
+      BasicBlock const *bb = mapped_cs->getParent();
+      mpi_calls.push_back({mapped_cs, call.kind, bb, bb->getParent()});
+      kind_offsets[static_cast<unsigned>(call.kind) + 1]++;
+    }
+  }
+  for (unsigned k = 0; k < NUM_MPI_CALL_KINDS; k++) {
+    kind_offsets[k + 1] += kind_offsets[k];
+  }
+
+  // NOTE: the blocks of the clone might be merged, therefore the checkpoints
+  //       are sorted again according to their new blocks
+  for (const MPICheckpoint &checkpoint : labelling.mpi_checkpoints) {
+    CallSite mapped_cs = map_call(checkpoint.cs);
+    if (mapped_cs) {
+      save_checkpoint(mapped_cs, checkpoint.type, checkpoint.kind);
     }
   }
+  sort_checkpoints();
+  ts.add_memory_counters(*this);
 }
 
 // Public API --------------------------------------------------------------- //
 
-Instruction *MPILabelling::get_unique_call(StringRef name) const {
+void MPILabelling::account_memory(MemoryAccounting::Snapshot &snapshot) const {
+  MemoryAccounting::Usage &usage = snapshot[MemoryAccounting::LABELLING_MAPS];
+
+  usage.count += fn_labels.size() + fn_kinds.size() + mpi_calls.size() +
+                 mpi_checkpoints.size() + bb_mpi_checkpoints.size();
+  usage.bytes += fn_labels.getMemorySize() + fn_kinds.getMemorySize() +
+                 mpi_calls.capacity() * sizeof(MPICall) +
+                 mpi_checkpoints.capacity() * sizeof(MPICheckpoint) +
+                 bb_mpi_checkpoints.getMemorySize();
+}
+
+Instruction *MPILabelling::get_unique_call(MPICallKind kind) const {
 
-  auto search = mpi_calls.find(name);
-  if (search == mpi_calls.end()) {
+  MPICallRange calls = get_mpi_calls(kind);
+  if (calls.begin() == calls.end()) {
     return nullptr;
   }
 
-  std::vector<CallSite> const &calls = search->second;
-  assert(calls.size() == 1 && "Expect single call.");
+  assert(std::next(calls.begin()) == calls.end() && "Expect single call.");
 
-  return calls[0].getInstruction();
+  return calls.begin()->cs.getInstruction();
 }
 
-std::vector<Instruction *> MPILabelling::get_calls(StringRef name) const {
-  auto search = mpi_calls.find(name);
-  if (search == mpi_calls.end()) {
-    return {}; // empty list
-  }
+std::vector<Instruction *> MPILabelling::get_calls(MPICallKind kind) const {
+  MPICallRange calls = get_mpi_calls(kind);
 
-  std::vector<CallSite> const &calls = search->second;
-  std::vector<Instruction *> instrs(calls.size());
-  std::generate(
-    instrs.begin(),
-    instrs.end(),
-    [it = calls.begin()] () mutable {
-      return (it++)->getInstruction();
-    });
+  std::vector<Instruction *> instrs;
+  instrs.reserve(std::distance(calls.begin(), calls.end()));
+  for (const MPICall &call : calls) {
+    instrs.push_back(call.cs.getInstruction());
+  }
   return instrs;
 }
 
+MPILabelling::MPICallRange MPILabelling::get_mpi_calls(MPICallKind kind) const {
+  unsigned k = static_cast<unsigned>(kind);
+  return make_range(mpi_calls.begin() + kind_offsets[k],
+                    mpi_calls.begin() + kind_offsets[k + 1]);
+}
+
+const std::vector<CallGraphNode *> &MPILabelling::get_roots() const {
+  return roots;
+}
+
 bool MPILabelling::is_sequential(Function const *f) const {
   return check_status<SEQUENTIAL>(f);
 }
@@ -75,85 +170,230 @@ bool MPILabelling::is_mpi_involved(Function const *f) const {
           check_status<MPI_INVOLVED_MEDIATELY>(f));
 }
 
-MPILabelling::MPICheckpoints
+MPILabelling::MPICheckpointRange
 MPILabelling::get_mpi_checkpoints(BasicBlock const *bb) const {
   auto search = bb_mpi_checkpoints.find(bb);
   if (search == bb_mpi_checkpoints.end()) {
-    return MPICheckpoints();
+    return make_range(mpi_checkpoints.end(), mpi_checkpoints.end());
   }
 
-  return search->second;
+  return make_range(mpi_checkpoints.begin() + search->second.first,
+                    mpi_checkpoints.begin() + search->second.second);
 }
 
 // Private methods ---------------------------------------------------------- //
 
+void MPILabelling::index_calls(Module &m) {
+  MPICalls calls;
+
+  CallFinder<Module>::for_each_call(m, [this, &calls] (CallSite cs) {
+    Function const *callee = cs.getCalledFunction();
+    if (!callee) {
+      return; // indirect call
+    }
+
+    // NOTE: the kind is resolved once per callee, the other calls of
+    //       the same function take it from the cache
+    auto it = fn_kinds.find(callee);
+    if (it == fn_kinds.end()) {
+      it = fn_kinds.insert({callee, get_mpi_call_kind(callee)}).first;
+    }
+    if (!is_mpi_call_kind(it->second)) {
+      return;
+    }
+
+    BasicBlock const *bb = cs->getParent();
+    Function const *caller = bb->getParent();
+    if (is_mpi_call_kind(get_mpi_call_kind(caller))) {
+      return; // MPI functions are not explored
+    }
+    calls.push_back({cs, it->second, bb, caller});
+  });
+
+  // only MPI functions are kept
+  for (auto it = fn_kinds.begin(); it != fn_kinds.end(); ++it) {
+    if (!is_mpi_call_kind(it->second)) {
+      fn_kinds.erase(it);
+    }
+  }
+
+  sort_calls_by_kind(std::move(calls));
+}
+
+void MPILabelling::find_roots(CallGraph &cg) {
+  // NOTE: the external calling node does not count as a caller, neither
+  //       does a recursive call of the function itself
+  SmallPtrSet<Function const *, 32> called;
+  for (const auto &node : cg) {
+    Function const *caller = node.first;
+    if (!caller) {
+      continue;
+    }
+    for (const CallGraphNode::CallRecord &cr : *node.second) {
+      Function const *callee = cr.second->getFunction();
+      if (callee && callee != caller) {
+        called.insert(callee);
+      }
+    }
+  }
+
+  // the order of the module keeps the roots deterministic
+  for (Function &f : cg.getModule()) {
+    if (!f.isDeclaration() && !called.count(&f)) {
+      roots.push_back(cg[&f]);
+    }
+  }
+  std::stable_partition(roots.begin(), roots.end(), [] (CallGraphNode *root) {
+    return root->getFunction()->getName() == "main";
+  });
+}
+
+void MPILabelling::sort_calls_by_kind(MPICalls &&calls) {
+  // NOTE: counting sort is stable, the program order is kept within a kind
+  kind_offsets.fill(0);
+  for (const MPICall &call : calls) {
+    kind_offsets[static_cast<unsigned>(call.kind) + 1]++;
+  }
+  for (unsigned k = 0; k < NUM_MPI_CALL_KINDS; k++) {
+    kind_offsets[k + 1] += kind_offsets[k];
+  }
+
+  MPICallKindOffsets next = kind_offsets;
+  mpi_calls.resize(calls.size());
+  for (MPICall &call : calls) {
+    mpi_calls[next[static_cast<unsigned>(call.kind)]++] = call;
+  }
+}
+
 MPILabelling::ExplorationState
-MPILabelling::explore_cgnode(CallGraphNode const *cgn) {
-  Function *f = cgn->getFunction();
+MPILabelling::get_callee_state(CallGraphNode const *callee,
+                               const SmallPtrSetImpl<CallGraphNode const *> &scc,
+                               bool scc_involved) const {
+  Function const *f = callee->getFunction();
   if (!f) { // external call
     return EXTERNAL;
   }
 
-  auto it = fn_labels.find(f);
-  if (it != fn_labels.end()) {
-    return it->getSecond();
+  if (fn_kinds.count(f)) {
+    return MPI_CALL;
   }
 
-  if (f->hasName() && f->getName().startswith("MPI_")) {
-    fn_labels[f] = MPI_CALL;
-    return MPI_CALL;
+  if (scc.count(callee)) {
+    // NOTE: a call within an SCC involves MPI if any of its members does
+    return scc_involved ? MPI_INVOLVED_MEDIATELY : PROCESSING;
   }
 
-  // NOTE: store the info that the function is currently being processed.
-  //       This helps to resolve recursive calls as it immediately returns
-  //       PROCESSING status.
-
-  // TODO: => TEST: make a test to simple function calling itself. => it has to end with sequential
-  fn_labels[f] = PROCESSING;
-
-  ExplorationState res_es = SEQUENTIAL;
-
-  for (const CallGraphNode::CallRecord &cr : *cgn) {
-    ExplorationState inner_es = SEQUENTIAL;
-
-    if (cr.first == nullptr) { // calling external node => black (opaque) transition in the MPN
-      inner_es = EXTERNAL;
-    } else {
-      CallSite call_site(cr.first);
-      CallGraphNode *called_cgn = cr.second;
-
-      ExplorationState const &es = explore_cgnode(called_cgn);
-      switch(es) {
-      case MPI_CALL:
-        mpi_calls[call_site.getCalledFunction()->getName()].push_back(call_site);
-        inner_es = MPI_INVOLVED;
-        save_checkpoint(call_site, MPICallType::DIRECT);
-        break;
-      case MPI_INVOLVED:
-      case MPI_INVOLVED_MEDIATELY:
-        inner_es = MPI_INVOLVED_MEDIATELY;
-        save_checkpoint(call_site, MPICallType::INDIRECT);
-        break;
-      case PROCESSING:
-      case SEQUENTIAL:
-      case EXTERNAL:
-        // do nothing
-        break;
-      }
+  auto it = fn_labels.find(f);
+  assert(it != fn_labels.end() && "Callees outside of the SCC have to be labelled.");
+  return it->getSecond();
+}
+
+void MPILabelling::label_scc(const std::vector<CallGraphNode const *> &scc) {
+  SmallPtrSet<CallGraphNode const *, 8> members;
+  for (CallGraphNode const *cgn : scc) {
+    Function const *f = cgn->getFunction();
+    if (!f) {
+      continue;
     }
+    if (fn_labels.count(f)) {
+      return; // the SCC has already been labelled
+    }
+    if (is_mpi_call_kind(get_mpi_call_kind(f))) {
+      fn_labels[f] = MPI_CALL; // MPI functions are not explored
+      continue;
+    }
+    members.insert(cgn);
+  }
 
-    if (res_es < inner_es) {
-      res_es = inner_es;
+  // join of the callees outside of the SCC, all the members share it
+  bool scc_involved = false;
+  for (CallGraphNode const *cgn : members) {
+    for (const CallGraphNode::CallRecord &cr : *cgn) {
+      if (cr.first != nullptr) {
+        ExplorationState es = get_callee_state(cr.second, members, false);
+        scc_involved |= (es >= MPI_CALL);
+      }
     }
   }
 
-  fn_labels[f] = res_es; // set the resulting status
-  return res_es;
+  // NOTE: the members are labelled in the order of the SCC, the checkpoints
+  //       are sorted by their positions once all the SCCs are labelled.
+  for (CallGraphNode const *cgn : scc) {
+    if (!members.count(cgn)) {
+      continue;
+    }
+
+    ExplorationState res_es = SEQUENTIAL;
+    for (const CallGraphNode::CallRecord &cr : *cgn) {
+      ExplorationState inner_es = SEQUENTIAL;
+
+      if (cr.first == nullptr) { // calling external node => black (opaque) transition in the MPN
+        inner_es = EXTERNAL;
+      } else {
+        CallSite call_site(cr.first);
+
+        switch(get_callee_state(cr.second, members, scc_involved)) {
+        case MPI_CALL:
+          inner_es = MPI_INVOLVED;
+          save_checkpoint(call_site, MPICallType::DIRECT,
+                          fn_kinds.lookup(call_site.getCalledFunction()));
+          break;
+        case MPI_INVOLVED:
+        case MPI_INVOLVED_MEDIATELY:
+          inner_es = MPI_INVOLVED_MEDIATELY;
+          save_checkpoint(call_site, MPICallType::INDIRECT, MPICallKind::NONE);
+          break;
+        case PROCESSING:
+        case SEQUENTIAL:
+        case EXTERNAL:
+          // do nothing
+          break;
+        }
+      }
+
+      if (res_es < inner_es) {
+        res_es = inner_es;
+      }
+    }
+
+    fn_labels[cgn->getFunction()] = res_es; // set the resulting status
+  }
 }
 
-void MPILabelling::save_checkpoint(CallSite cs, MPICallType call_type) {
+void MPILabelling::save_checkpoint(CallSite cs, MPICallType call_type, MPICallKind kind) {
   BasicBlock *bb = cs->getParent();
   assert(bb != nullptr && "Null parent of instruction.");
 
-  bb_mpi_checkpoints[bb].emplace(cs, call_type);
+  mpi_checkpoints.push_back({cs, call_type, kind});
+}
+
+void MPILabelling::sort_checkpoints() {
+  // NOTE: the order of the calls within a block is given by a walk over its
+  //       instructions, the blocks without checkpoints are not visited
+  DenseMap<Instruction const *, unsigned> unsorted;
+  std::vector<BasicBlock const *> bbs;
+  for (unsigned idx = 0; idx < mpi_checkpoints.size(); idx++) {
+    Instruction const *inst = mpi_checkpoints[idx].cs.getInstruction();
+    unsorted[inst] = idx;
+    bbs.push_back(inst->getParent());
+  }
+
+  std::sort(bbs.begin(), bbs.end());
+  bbs.erase(std::unique(bbs.begin(), bbs.end()), bbs.end());
+
+  MPICheckpoints sorted;
+  sorted.reserve(unsorted.size());
+  bb_mpi_checkpoints.clear();
+  bb_mpi_checkpoints.reserve(bbs.size());
+  for (BasicBlock const *bb : bbs) {
+    unsigned first = sorted.size();
+    for (const Instruction &inst : *bb) {
+      auto search = unsorted.find(&inst);
+      if (search != unsorted.end()) {
+        sorted.push_back(mpi_checkpoints[search->second]);
+      }
+    }
+    bb_mpi_checkpoints[bb] = {first, static_cast<unsigned>(sorted.size())};
+  }
+  mpi_checkpoints = std::move(sorted);
 }
@@ -1,11 +1,10 @@
 
 #include "morpheus/Analysis/MPIScopeAnalysis.hpp"
+#include "morpheus/Support/Instrumentation.hpp"
 
 #include "llvm/Analysis/CallGraph.h"
-#include "llvm/Analysis/ModuleSummaryAnalysis.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Dominators.h"
-#include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace llvm {
@@ -26,11 +25,8 @@ using namespace llvm;
 MPIScopeAnalysis::Result
 MPIScopeAnalysis::run(Module &m, ModuleAnalysisManager &mam) {
 
-  ModuleSummaryIndex &index = mam.getResult<ModuleSummaryIndexAnalysis>(m);
   MPILabelling &labelling = mam.getResult<MPILabellingAnalysis>(m);
-  CallGraph &cg = mam.getResult<CallGraphAnalysis>(m);
-
-  return MPIScope(index, labelling, cg);
+  return MPIScope(labelling);
 }
 
 // provide definition of the analysis Key
@@ -39,95 +35,76 @@ AnalysisKey MPIScopeAnalysis::Key;
 // -------------------------------------------------------------------------- //
 // MPIScope
 
-MPIScope::MPIScope(ModuleSummaryIndex &index, MPILabelling &labelling, CallGraph &cg) {
+MPIScope::MPIScope(MPILabelling &labelling) {
+  TimeScope ts("MPIScope");
 
-  Instruction *mpi_init_call = labelling.get_unique_call("MPI_Init");
-  Instruction *mpi_fin_call = labelling.get_unique_call("MPI_Finalize");
+  Instruction *mpi_init_call = labelling.get_unique_call(MPICallKind::INIT);
+  Instruction *mpi_fin_call = labelling.get_unique_call(MPICallKind::FINALIZE);
   if (!mpi_init_call || !mpi_fin_call) {
     // errs() << "There is no MPI area defined by MPI_Init & MPI_Finalize calls.\n";
     scope_fn = nullptr;
     return;
   }
 
-  // remove old instruction-calls tracks
-  instruction_calls_track.clear();
-
-  // use the index to calculate root functions (those which are not called)
-  FunctionSummary root_nodes = index.calculateCallGraphRoot();
-  ArrayRef<FunctionSummary::EdgeTy> edges = root_nodes.calls();
-
-  // filter the root nodes from the call graph and count number of call instructions
-  unsigned int call_inst_count = 0;
-  std::vector<CallGraphNode *> cg_roots;
-  cg_roots.reserve(edges.size());
-
-  // filter root nodes from call graph
-  for (const std::pair<ValueInfo, CalleeInfo> &edge : edges) {
-    StringRef fn_name = std::get<ValueInfo>(edge).name();
-    for (const auto &node : cg) {
-      CallGraphNode *cgn = node.second.get();
-      Function *fn = cgn->getFunction();
-      if (fn && fn_name == fn->getName()) {
-        cg_roots.push_back(cgn); // store root node
-        call_inst_count += cgn->size(); // add number of called functions from root node
-      }
+  // only the roots (functions without callers) that involve MPI can reach
+  // MPI_Init/Finalize, 'main' goes first
+  for (CallGraphNode const *root : labelling.get_roots()) {
+    if (labelling.is_mpi_involved(root->getFunction())) {
+      process_root(root);
     }
   }
 
-  // reserve the size of unordered map with instructions pointing to its call track
-  instruction_calls_track.reserve(call_inst_count);
-
-  // process root nodes
-  for (CallGraphNode *cgn : cg_roots) {
-    Function *fn = cgn->getFunction();
-    VisitedNodes vn;
-    vn.reserve(cgn->size());
-    process_cgnode(cgn, CallNode::create({std::nullopt, fn}), vn);
-  }
-
   /*
   // Testing print
-  for (auto &p : instruction_calls_track) {
-    CallsTrack &ct = p.second;
-    errs() << *p.first << "(" << p.first << ") - [" << *ct << "]\n";
+  for (Instruction *inst : {mpi_init_call, mpi_fin_call}) {
+    errs() << *inst << " - [";
+    print_track(errs(), call_nodes, get_calls_track(inst));
+    errs() << "]\n";
   }
   */
 
   // calculate the scope function
   // NOTE: current implementation counts on singe call of MPI_Init/Finalize.
-  CallsTrack &ct_init = instruction_calls_track[mpi_init_call];
-  CallsTrack &ct_finalize = instruction_calls_track[mpi_fin_call];
-
-  CallsTrack deeper, shallower;
-  if (ct_init->get_depth() > ct_finalize->get_depth()) {
-    deeper = ct_init;
-    shallower = ct_finalize;
-  } else {
-    deeper = ct_finalize;
-    shallower = ct_init;
+  CallsTrack ct_init = get_calls_track(mpi_init_call);
+  CallsTrack ct_finalize = get_calls_track(mpi_fin_call);
+
+  // the common predecessor of direct callers of MPI_Init/Finalize, if there is any
+  CallsTrack common = CallNodes::NONE;
+  if (ct_init != CallNodes::NONE && ct_finalize != CallNodes::NONE) {
+    common = call_nodes.get_common_ancestor(call_nodes.get_parent(ct_init),
+                                            call_nodes.get_parent(ct_finalize));
   }
 
-  // start with a direct caller of MPI_Init/Finalize
-  CallsTrack dp = deeper->get_parent();
-  CallsTrack sp = shallower->get_parent();
-
-  // equalize the depth levels
-  while (dp->get_depth() > sp->get_depth()) {
-    dp = dp->get_parent();
+  if (common != CallNodes::NONE) { // MPI Scope
+    scope_fn = call_nodes[common].data.second;
+    loop_info = LoopInfo(DominatorTree(*scope_fn));
+  } else { // NO Scope
+    scope_fn = nullptr;
   }
+  ts.add_counter("call_nodes", call_nodes.size());
+  ts.add_memory_counters(*this);
+}
 
-  // continue up to the common predecessor, if there is any
-  while(dp != sp || dp->get_depth() > 0) {
-    dp = dp->get_parent();
-    sp = sp->get_parent();
-  }
+void MPIScope::account_memory(MemoryAccounting::Snapshot &snapshot) const {
+  MemoryAccounting::Usage &usage = snapshot[MemoryAccounting::SCOPE_CALL_TRACKS];
 
-  if (dp == sp) { // MPI Scope
-    scope_fn = dp->data.second;
-    loop_info = LoopInfo(DominatorTree(*scope_fn));
-  } else { // NO Scope
+  usage.count += call_nodes.size();
+  usage.bytes += call_nodes.get_memory_size() +
+                 function_tracks.getMemorySize() +
+                 instruction_calls_track.getMemorySize();
+}
+
+MPIScope::MPIScope(const MPIScope &scope, const ValueToValueMapTy &vmap) {
+  TimeScope ts("MPIScope", "clone");
+  if (!scope.scope_fn) {
     scope_fn = nullptr;
+    return;
   }
+
+  // NOTE: the tracks of calls are needed only to find the scope function,
+  //       hence they are not transferred.
+  scope_fn = cast<Function>(vmap.lookup(scope.scope_fn));
+  loop_info = LoopInfo(DominatorTree(*scope_fn));
 }
 
 Function *MPIScope::getFunction() {
@@ -144,23 +121,58 @@ bool MPIScope::isValid() {
 
 // private members ---------------------------------------------------------- //
 
-void MPIScope::process_cgnode(CallGraphNode const *cgn, const CallsTrack &track, VisitedNodes &visited) {
-
-  if (visited.count(cgn) == 1) {
+void MPIScope::process_root(CallGraphNode const *root) {
+  Function *root_fn = root->getFunction();
+  if (function_tracks.count(root_fn)) {
     return;
   }
 
-  visited[cgn] = true;
+  // NOTE: the explicit stack keeps the order of a recursive DFS, each frame
+  //       holds a node, its track and the next call record to process
+  struct Frame {
+    CallGraphNode const *cgn;
+    CallsTrack track;
+    CallGraphNode::const_iterator next;
+  };
+
+  CallsTrack root_track = call_nodes.create({std::nullopt, root_fn});
+  function_tracks[root_fn] = root_track;
+
+  std::vector<Frame> stack;
+  stack.push_back({root, root_track, root->begin()});
+  while (!stack.empty()) {
+    Frame &frame = stack.back();
+    if (frame.next == frame.cgn->end()) {
+      stack.pop_back();
+      continue;
+    }
 
-  for (const CallGraphNode::CallRecord &cr : *cgn) {
+    const CallGraphNode::CallRecord &cr = *frame.next++;
     Function *fn = cr.second->getFunction();
-    if (fn) { // process only non-external nodes
-      Instruction *inst = CallSite(cr.first).getInstruction();
-      CallsTrack ct = CallNode::create({inst, fn});
-      ct->set_parent(track);
-
-      instruction_calls_track.insert({inst, ct});
-      process_cgnode(cr.second, ct, visited);
+    if (!fn || function_tracks.count(fn)) { // process only non-external and new nodes
+      continue;
     }
+
+    Instruction *inst = CallSite(cr.first).getInstruction();
+    CallsTrack track = call_nodes.create({inst, fn}, frame.track);
+    function_tracks[fn] = track;
+    stack.push_back({cr.second, track, cr.second->begin()});
   }
 }
+
+MPIScope::CallsTrack MPIScope::get_calls_track(Instruction *inst) {
+  auto search = instruction_calls_track.find(inst);
+  if (search != instruction_calls_track.end()) {
+    return search->second;
+  }
+
+  // the call continues the track of its function, if it is reachable from a root
+  CallsTrack track = CallNodes::NONE;
+  auto caller = function_tracks.find(inst->getFunction());
+  if (caller != function_tracks.end()) {
+    track = call_nodes.create({inst, CallSite(inst).getCalledFunction()}, caller->second);
+  }
+
+  instruction_calls_track[inst] = track;
+  return track;
+}
@@ -0,0 +1,132 @@
+
+#include "morpheus/Analysis/MPISlice.hpp"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+
+using namespace llvm;
+
+// -------------------------------------------------------------------------- //
+// MPISlice
+
+MPISlice::MPISlice(const Function &fn, const LoopInfo &loop_info, const MPILabelling &labelling) {
+
+  compute_control_dependences(fn);
+
+  // the CFG_CN is entered by the entry block and left by the exit blocks
+  add(&fn.getEntryBlock());
+  for (const BasicBlock &bb : fn) {
+    if (succ_empty(&bb)) {
+      add(&bb);
+    }
+  }
+
+  for (const BasicBlock &bb : fn) {
+    for (const MPILabelling::MPICheckpoint &checkpoint : labelling.get_mpi_checkpoints(&bb)) {
+      add(&bb);
+      for (const Use &arg : checkpoint.cs.args()) {
+        add_argument_dependences(arg.get());
+      }
+    }
+  }
+  close();
+
+  // NOTE: the loops around the slice are exposed by CFG_CN (see expose_loops),
+  //       hence their latches and exit blocks are the part of the slice as
+  //       well. The new blocks may bring new control dependences.
+  size_t size;
+  do {
+    size = blocks.size();
+    for (const Loop *loop : loop_info) {
+      add_loop_structure(*loop);
+    }
+    close();
+  } while (size != blocks.size());
+}
+
+// The control dependences by Ferrante et al.: a block B is control dependent
+// on A if A has a successor S such that B post-dominates S, but B does not
+// strictly post-dominate A. The blocks are found by the walk from S up to
+// the immediate post-dominator of A.
+void MPISlice::compute_control_dependences(const Function &fn) {
+  PostDominatorTree pdt(const_cast<Function &>(fn));
+
+  for (const BasicBlock &bb : fn) {
+    DomTreeNode *bb_node = pdt.getNode(const_cast<BasicBlock *>(&bb));
+    if (!bb_node || bb.getTerminator()->getNumSuccessors() < 2) {
+      continue;
+    }
+    DomTreeNode *ipdom = bb_node->getIDom();
+
+    for (const BasicBlock *succ : successors(&bb)) {
+      DomTreeNode *runner = pdt.getNode(const_cast<BasicBlock *>(succ));
+      while (runner && runner != ipdom && runner->getBlock()) {
+        SmallVectorImpl<BasicBlock const *> &deps = control_dependences[runner->getBlock()];
+        if (deps.empty() || deps.back() != &bb) {
+          deps.push_back(&bb);
+        }
+        runner = runner->getIDom();
+      }
+    }
+  }
+}
+
+// NOTE: the net does not model the computation, yet the branches that select
+//       the value of an MPI argument (through phi nodes) are kept. The values
+//       passed through memory are not followed.
+void MPISlice::add_argument_dependences(const Value *arg) {
+  SmallPtrSet<const Value *, 16> visited;
+  SmallVector<const Value *, 16> worklist{arg};
+
+  while (!worklist.empty()) {
+    const Value *v = worklist.pop_back_val();
+    const Instruction *inst = dyn_cast<Instruction>(v);
+    if (!inst || !visited.insert(inst).second) {
+      continue;
+    }
+    if (const PHINode *phi = dyn_cast<PHINode>(inst)) {
+      for (const BasicBlock *incoming : phi->blocks()) {
+        add(incoming);
+      }
+    }
+    for (const Use &op : inst->operands()) {
+      worklist.push_back(op.get());
+    }
+  }
+}
+
+void MPISlice::add_loop_structure(const Loop &loop) {
+  // NOTE: a loop with header out of the slice is collapsed, but it still
+  //       may contain a sub-loop that is not
+  if (contains(loop.getHeader())) {
+    if (BasicBlock const *latch = loop.getLoopLatch()) {
+      add(latch);
+    }
+    if (BasicBlock const *exit = loop.getExitBlock()) {
+      add(exit);
+    }
+  }
+  for (const Loop *subloop : loop) {
+    add_loop_structure(*subloop);
+  }
+}
+
+void MPISlice::add(BasicBlock const *bb) {
+  if (blocks.insert(bb).second) {
+    pending.push_back(bb);
+  }
+}
+
+void MPISlice::close() {
+  while (!pending.empty()) {
+    BasicBlock const *bb = pending.pop_back_val();
+    auto found = control_dependences.find(bb);
+    if (found != control_dependences.end()) {
+      for (BasicBlock const *branch : found->second) {
+        add(branch);
+      }
+    }
+  }
+}
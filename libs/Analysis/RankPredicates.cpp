@@ -0,0 +1,317 @@
+
+#include "morpheus/Analysis/RankPredicates.hpp"
+#include "morpheus/Analysis/MPISlice.hpp"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace llvm;
+
+namespace {
+  // NOTE: the expressions of rank are expected to be short, the deeper
+  //       ones are not taken as predicates
+  constexpr unsigned MAX_DEPTH = 16;
+
+  // NOTE: the arithmetic is done on unsigned values, it wraps around as in
+  //       the IR, and the result is truncated to the bits of the type
+  int64_t truncate(uint64_t value, unsigned bits) {
+    if (bits >= 64) {
+      return int64_t(value);
+    }
+    uint64_t mask = (uint64_t(1) << bits) - 1;
+    uint64_t sign = uint64_t(1) << (bits - 1);
+    uint64_t low = value & mask;
+    return int64_t((low ^ sign) - sign); // sign extension of the low bits
+  }
+
+  int64_t get_signed_min(unsigned bits) {
+    return bits >= 64 ? std::numeric_limits<int64_t>::min() : -(int64_t(1) << (bits - 1));
+  }
+
+  uint64_t as_unsigned(int64_t value, unsigned bits) {
+    return bits >= 64 ? uint64_t(value) : uint64_t(value) & ((uint64_t(1) << bits) - 1);
+  }
+
+  std::string print_predicate(CmpInst::Predicate predicate) {
+    switch (predicate) {
+      case CmpInst::ICMP_EQ:  return "==";
+      case CmpInst::ICMP_NE:  return "!=";
+      case CmpInst::ICMP_SGT:
+      case CmpInst::ICMP_UGT: return ">";
+      case CmpInst::ICMP_SGE:
+      case CmpInst::ICMP_UGE: return ">=";
+      case CmpInst::ICMP_SLT:
+      case CmpInst::ICMP_ULT: return "<";
+      case CmpInst::ICMP_SLE:
+      case CmpInst::ICMP_ULE: return "<=";
+      default:                return "?";
+    }
+  }
+
+  std::string print_opcode(unsigned opcode) {
+    switch (opcode) {
+      case Instruction::Add:  return "+";
+      case Instruction::Sub:  return "-";
+      case Instruction::Mul:  return "*";
+      case Instruction::SDiv:
+      case Instruction::UDiv: return "/";
+      case Instruction::SRem:
+      case Instruction::URem: return "%";
+      case Instruction::And:  return "&";
+      case Instruction::Or:   return "|";
+      case Instruction::Xor:  return "^";
+      case Instruction::Shl:  return "<<";
+      case Instruction::LShr:
+      case Instruction::AShr: return ">>";
+      default:                return "?";
+    }
+  }
+} // end of anonymous namespace
+
+// -------------------------------------------------------------------------- //
+// RankPredicates
+
+RankPredicates::RankPredicates(const Module &m, const MPILabelling &labelling, unsigned nproc,
+                               ArrayRef<unsigned> ranks)
+  : nproc(nproc) {
+
+  auto collect_loads = [] (const std::vector<Instruction *> &calls, DenseSet<const Value *> &values,
+                           bool comm_world_only) {
+    for (Instruction *call : calls) {
+      if (comm_world_only && !is_comm_world(CallSite(call).getArgument(0))) {
+        continue;
+      }
+      Value *output = CallSite(call).getArgument(1);
+      for (const User *user : output->users()) {
+        if (isa<LoadInst>(user)) {
+          values.insert(user);
+        }
+      }
+    }
+  };
+  collect_loads(labelling.get_calls(MPICallKind::COMM_RANK), rank_values, false);
+  // NOTE: the sizes of the other communicators stay unknown (see is_comm_world)
+  collect_loads(labelling.get_calls(MPICallKind::COMM_SIZE), size_values, true);
+
+  if (rank_values.empty()) {
+    return;
+  }
+
+  // NOTE: only the branches within the slices (see MPISlice) guard the
+  //       checkpoints, the other ones are collapsed in the nets anyway
+  for (const Function &fn : m) {
+    if (fn.isDeclaration() || !labelling.is_mpi_involved(&fn)) {
+      continue;
+    }
+    DominatorTree dt(const_cast<Function &>(fn));
+    LoopInfo loop_info(dt);
+    MPISlice slice(fn, loop_info, labelling);
+
+    for (const BasicBlock &bb : fn) {
+      const BranchInst *branch = dyn_cast<BranchInst>(bb.getTerminator());
+      if (!branch || !branch->isConditional() || !slice.contains(&bb)) {
+        continue;
+      }
+      const Value *cond = branch->getCondition();
+      auto evaluable = [this, cond] (unsigned rank) { return eval(cond, rank).hasValue(); };
+      if (depends_on_rank(cond) && std::all_of(ranks.begin(), ranks.end(), evaluable)) {
+        branches.push_back(const_cast<BranchInst *>(branch));
+      }
+    }
+  }
+}
+
+RankPredicates::Outcomes RankPredicates::evaluate(unsigned rank) const {
+  Outcomes outcomes;
+  outcomes.reserve(branches.size());
+  for (BranchInst const *branch : branches) {
+    Optional<int64_t> outcome = eval(branch->getCondition(), rank);
+    assert(outcome.hasValue() && "The predicate is not evaluable for the rank.");
+    outcomes.push_back(*outcome != 0);
+  }
+  return outcomes;
+}
+
+std::string RankPredicates::describe(const Outcomes &outcomes) const {
+  std::vector<std::string> conjuncts;
+  for (size_t idx = 0; idx < branches.size(); idx++) {
+    const Value *cond = branches[idx]->getCondition();
+
+    std::string conjunct;
+    if (const ICmpInst *cmp = dyn_cast<ICmpInst>(cond)) {
+      CmpInst::Predicate predicate = outcomes[idx] ? cmp->getPredicate()
+                                                   : cmp->getInversePredicate();
+      conjunct = print(cmp->getOperand(0)) + " " + print_predicate(predicate)
+                 + " " + print(cmp->getOperand(1));
+    } else {
+      conjunct = outcomes[idx] ? print(cond) : "!" + print(cond);
+    }
+
+    // the same predicate may guard more branches
+    if (std::find(conjuncts.begin(), conjuncts.end(), conjunct) == conjuncts.end()) {
+      conjuncts.push_back(conjunct);
+    }
+  }
+
+  if (conjuncts.empty()) {
+    return "true";
+  }
+  std::string description = conjuncts.front();
+  for (auto it = std::next(conjuncts.begin()); it != conjuncts.end(); it++) {
+    description += " && " + *it;
+  }
+  return description;
+}
+
+Optional<int64_t> RankPredicates::eval(const Value *v, unsigned rank, unsigned depth) const {
+  if (depth > MAX_DEPTH) {
+    return None;
+  }
+  if (rank_values.count(v)) {
+    return int64_t(rank);
+  }
+  if (size_values.count(v)) {
+    return int64_t(nproc);
+  }
+
+  if (const ConstantInt *c = dyn_cast<ConstantInt>(v)) {
+    if (c->getBitWidth() > 64) {
+      return None;
+    }
+    return c->getBitWidth() == 1 ? int64_t(c->getZExtValue()) : c->getSExtValue();
+  }
+
+  if (const CastInst *cast = dyn_cast<CastInst>(v)) {
+    Optional<int64_t> value = eval(cast->getOperand(0), rank, depth + 1);
+    if (!value) {
+      return None;
+    }
+    unsigned src_bits = cast->getSrcTy()->getScalarSizeInBits();
+    switch (cast->getOpcode()) {
+      case Instruction::SExt:  return *value;
+      case Instruction::ZExt:  return int64_t(as_unsigned(*value, src_bits));
+      case Instruction::Trunc: return truncate(*value, cast->getDestTy()->getScalarSizeInBits());
+      default:                 return None;
+    }
+  }
+
+  if (const SelectInst *select = dyn_cast<SelectInst>(v)) {
+    Optional<int64_t> cond = eval(select->getCondition(), rank, depth + 1);
+    if (!cond) {
+      return None;
+    }
+    return eval(*cond ? select->getTrueValue() : select->getFalseValue(), rank, depth + 1);
+  }
+
+  if (const ICmpInst *cmp = dyn_cast<ICmpInst>(v)) {
+    Optional<int64_t> lhs = eval(cmp->getOperand(0), rank, depth + 1);
+    Optional<int64_t> rhs = eval(cmp->getOperand(1), rank, depth + 1);
+    if (!lhs || !rhs) {
+      return None;
+    }
+    unsigned bits = cmp->getOperand(0)->getType()->getScalarSizeInBits();
+    uint64_t ulhs = as_unsigned(*lhs, bits), urhs = as_unsigned(*rhs, bits);
+    switch (cmp->getPredicate()) {
+      case CmpInst::ICMP_EQ:  return int64_t(*lhs == *rhs);
+      case CmpInst::ICMP_NE:  return int64_t(*lhs != *rhs);
+      case CmpInst::ICMP_SGT: return int64_t(*lhs > *rhs);
+      case CmpInst::ICMP_SGE: return int64_t(*lhs >= *rhs);
+      case CmpInst::ICMP_SLT: return int64_t(*lhs < *rhs);
+      case CmpInst::ICMP_SLE: return int64_t(*lhs <= *rhs);
+      case CmpInst::ICMP_UGT: return int64_t(ulhs > urhs);
+      case CmpInst::ICMP_UGE: return int64_t(ulhs >= urhs);
+      case CmpInst::ICMP_ULT: return int64_t(ulhs < urhs);
+      case CmpInst::ICMP_ULE: return int64_t(ulhs <= urhs);
+      default:                return None;
+    }
+  }
+
+  if (const BinaryOperator *op = dyn_cast<BinaryOperator>(v)) {
+    Optional<int64_t> lhs = eval(op->getOperand(0), rank, depth + 1);
+    Optional<int64_t> rhs = eval(op->getOperand(1), rank, depth + 1);
+    if (!lhs || !rhs) {
+      return None;
+    }
+    unsigned bits = op->getType()->getScalarSizeInBits();
+    uint64_t ulhs = as_unsigned(*lhs, bits), urhs = as_unsigned(*rhs, bits);
+    switch (op->getOpcode()) {
+      case Instruction::Add:  return truncate(ulhs + urhs, bits);
+      case Instruction::Sub:  return truncate(ulhs - urhs, bits);
+      case Instruction::Mul:  return truncate(ulhs * urhs, bits);
+      case Instruction::And:  return *lhs & *rhs;
+      case Instruction::Or:   return *lhs | *rhs;
+      case Instruction::Xor:  return *lhs ^ *rhs;
+      // NOTE: the overflow of the signed division (MIN / -1) is undefined in IR too
+      case Instruction::SDiv:
+        return (*rhs && !(*rhs == -1 && *lhs == get_signed_min(bits)))
+          ? Optional<int64_t>(*lhs / *rhs) : None;
+      case Instruction::SRem:
+        return (*rhs && !(*rhs == -1 && *lhs == get_signed_min(bits)))
+          ? Optional<int64_t>(*lhs % *rhs) : None;
+      case Instruction::UDiv: return urhs ? Optional<int64_t>(truncate(ulhs / urhs, bits)) : None;
+      case Instruction::URem: return urhs ? Optional<int64_t>(truncate(ulhs % urhs, bits)) : None;
+      case Instruction::Shl:
+        return urhs < bits ? Optional<int64_t>(truncate(ulhs << urhs, bits)) : None;
+      case Instruction::LShr:
+        return urhs < bits ? Optional<int64_t>(truncate(ulhs >> urhs, bits)) : None;
+      case Instruction::AShr:
+        return urhs < bits ? Optional<int64_t>(*lhs >> urhs) : None;
+      default:
+        return None;
+    }
+  }
+  return None;
+}
+
+bool RankPredicates::depends_on_rank(const Value *v, unsigned depth) const {
+  if (rank_values.count(v)) {
+    return true;
+  }
+  if (depth > MAX_DEPTH) {
+    return false;
+  }
+  if (isa<CastInst>(v) || isa<SelectInst>(v) || isa<ICmpInst>(v) || isa<BinaryOperator>(v)) {
+    for (const Use &op : cast<User>(v)->operands()) {
+      if (depends_on_rank(op.get(), depth + 1)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::string RankPredicates::print(const Value *v) const {
+  if (rank_values.count(v)) {
+    return "rank";
+  }
+  if (size_values.count(v)) {
+    return "size";
+  }
+  if (const ConstantInt *c = dyn_cast<ConstantInt>(v)) {
+    if (c->getBitWidth() == 1) {
+      return c->isOne() ? "true" : "false";
+    }
+    return std::to_string(c->getSExtValue());
+  }
+  if (const CastInst *cast = dyn_cast<CastInst>(v)) {
+    return print(cast->getOperand(0));
+  }
+  if (const SelectInst *select = dyn_cast<SelectInst>(v)) {
+    return "(" + print(select->getCondition()) + " ? " + print(select->getTrueValue())
+           + " : " + print(select->getFalseValue()) + ")";
+  }
+  if (const ICmpInst *cmp = dyn_cast<ICmpInst>(v)) {
+    return "(" + print(cmp->getOperand(0)) + " " + print_predicate(cmp->getPredicate())
+           + " " + print(cmp->getOperand(1)) + ")";
+  }
+  if (const BinaryOperator *op = dyn_cast<BinaryOperator>(v)) {
+    return "(" + print(op->getOperand(0)) + " " + print_opcode(op->getOpcode())
+           + " " + print(op->getOperand(1)) + ")";
+  }
+  return "?";
+}
@@ -0,0 +1,128 @@
+
+#include "morpheus/Support/Instrumentation.hpp"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+
+// -------------------------------------------------------------------------- //
+// Instrumentation
+
+Instrumentation &Instrumentation::get() {
+  static Instrumentation instrumentation;
+  return instrumentation;
+}
+
+unsigned Instrumentation::get_thread_id() {
+  static std::atomic<unsigned> next_id(0);
+  thread_local unsigned id = next_id++;
+  return id;
+}
+
+void Instrumentation::add_event(Event event) {
+  std::lock_guard<std::mutex> lock(mtx);
+  events.push_back(std::move(event));
+}
+
+void Instrumentation::clear() {
+  std::lock_guard<std::mutex> lock(mtx);
+  events.clear();
+  events.shrink_to_fit();
+}
+
+static int64_t to_us(Instrumentation::Clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void Instrumentation::write_summary(raw_ostream &os) const {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  struct Phase {
+    int64_t count = 0;
+    Clock::duration total = Clock::duration::zero();
+    Clock::duration max = Clock::duration::zero();
+    std::map<std::string, int64_t> counters;
+  };
+
+  std::map<std::string, Phase> phases;
+  for (const Event &event : events) {
+    Phase &phase = phases[event.name];
+    phase.count++;
+    phase.total += event.duration;
+    phase.max = std::max(phase.max, event.duration);
+    for (const auto &counter : event.counters) {
+      int64_t &value = phase.counters[counter.first];
+      if (StringRef(counter.first).startswith("mem_")) {
+        value = std::max(value, counter.second);
+      } else {
+        value += counter.second;
+      }
+    }
+  }
+
+  json::Object summary;
+  for (const auto &entry : phases) {
+    const Phase &phase = entry.second;
+
+    json::Object counters;
+    for (const auto &counter : phase.counters) {
+      counters[counter.first] = counter.second;
+    }
+
+    summary[entry.first] = json::Object{
+      {"count", phase.count},
+      {"total_us", to_us(phase.total)},
+      {"max_us", to_us(phase.max)},
+      {"counters", std::move(counters)},
+    };
+  }
+  os << json::Value(std::move(summary)) << "\n";
+}
+
+void Instrumentation::write_trace(raw_ostream &os) const {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  json::Array trace_events;
+  for (const Event &event : events) {
+    json::Object args;
+    if (!event.detail.empty()) {
+      args["detail"] = event.detail;
+    }
+    for (const auto &counter : event.counters) {
+      args[counter.first] = counter.second;
+    }
+
+    trace_events.push_back(json::Object{
+      {"name", event.name},
+      {"ph", "X"},
+      {"pid", 1},
+      {"tid", int64_t(event.tid)},
+      {"ts", to_us(event.start - epoch)},
+      {"dur", to_us(event.duration)},
+      {"args", std::move(args)},
+    });
+  }
+  os << json::Value(json::Object{{"traceEvents", std::move(trace_events)}}) << "\n";
+}
+
+bool Instrumentation::write(StringRef path) const {
+  std::error_code ec;
+  raw_fd_ostream trace_os(path, ec, sys::fs::F_Text);
+  if (ec) {
+    errs() << "Cannot write the time trace to '" << path << "': " << ec.message() << "\n";
+    return false;
+  }
+  write_trace(trace_os);
+
+  raw_fd_ostream summary_os((path + ".summary.json").str(), ec, sys::fs::F_Text);
+  if (ec) {
+    errs() << "Cannot write the summary to '" << path << ".summary.json': " << ec.message() << "\n";
+    return false;
+  }
+  write_summary(summary_os);
+  return true;
+}
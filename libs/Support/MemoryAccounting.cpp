@@ -0,0 +1,125 @@
+
+#include "morpheus/Support/MemoryAccounting.hpp"
+
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+// -------------------------------------------------------------------------- //
+// utilities
+
+static void update_max(std::atomic<int64_t> &max, int64_t value) {
+  int64_t current = max.load();
+  while (current < value && !max.compare_exchange_weak(current, value)) { }
+}
+
+// -------------------------------------------------------------------------- //
+// MemoryAccounting
+
+MemoryAccounting &MemoryAccounting::get() {
+  static MemoryAccounting accounting;
+  return accounting;
+}
+
+StringRef MemoryAccounting::get_name(Category category) {
+  switch (category) {
+  case PLACES:              return "places";
+  case TRANSITIONS:         return "transitions";
+  case EDGES:               return "edges";
+  case UNRESOLVED_ELEMENTS: return "unresolved elements";
+  case NET_STRINGS:         return "strings of nets";
+  case EDGE_VECTORS:        return "leads_to/referenced_by";
+  case GUARDS:              return "guards";
+  case SCOPE_CALL_TRACKS:   return "MPIScope call tracks";
+  case LABELLING_MAPS:      return "MPILabelling maps";
+  default:                  return "unknown";
+  }
+}
+
+int64_t &MemoryAccounting::get_thread_bytes() {
+  thread_local int64_t bytes = 0;
+  return bytes;
+}
+
+int64_t &MemoryAccounting::get_thread_peak() {
+  thread_local int64_t peak = 0;
+  return peak;
+}
+
+void MemoryAccounting::allocate(Category category, size_t bytes) {
+  if (!enabled) {
+    return;
+  }
+
+  Counter &counter = counters[category];
+  counter.count++;
+  counter.allocations++;
+  update_max(counter.peak_bytes, counter.bytes += bytes);
+  update_max(total_peak_bytes, total_bytes += bytes);
+
+  int64_t &thread_bytes = get_thread_bytes();
+  thread_bytes += bytes;
+  get_thread_peak() = std::max(get_thread_peak(), thread_bytes);
+}
+
+void MemoryAccounting::deallocate(Category category, size_t bytes) {
+  if (!enabled) {
+    return;
+  }
+
+  Counter &counter = counters[category];
+  counter.count--;
+  counter.bytes -= bytes;
+  total_bytes -= bytes;
+  get_thread_bytes() -= bytes;
+}
+
+void MemoryAccounting::record(const Snapshot &snapshot) {
+  if (!enabled) {
+    return;
+  }
+
+  for (unsigned c = 0; c < NUM_CATEGORIES; c++) {
+    if (snapshot[c].count == 0 && snapshot[c].bytes == 0) {
+      continue;
+    }
+    // NOTE: the estimated categories keep the largest snapshot
+    Counter &counter = counters[c];
+    update_max(counter.count, snapshot[c].count);
+    update_max(counter.peak_bytes, snapshot[c].bytes);
+  }
+}
+
+void MemoryAccounting::record_phase_peak(StringRef phase, int64_t bytes) {
+  std::lock_guard<std::mutex> lock(mtx);
+  int64_t &peak = phase_peaks[phase.str()];
+  peak = std::max(peak, bytes);
+}
+
+void MemoryAccounting::print_report(raw_ostream &os) const {
+  os << "Memory accounting (exact: live / peak bytes, count, allocations; "
+        "estimated: peak bytes, count)\n";
+
+  for (unsigned c = 0; c < NUM_CATEGORIES; c++) {
+    const Counter &counter = counters[c];
+    os << "  " << left_justify(get_name(Category(c)), 24);
+    if (c < NET_STRINGS) {
+      os << format("%12lld / %12lld B  %10lld  %10lld\n",
+                   (long long)counter.bytes, (long long)counter.peak_bytes,
+                   (long long)counter.count, (long long)counter.allocations);
+    } else {
+      os << format("%27lld B  %10lld\n",
+                   (long long)counter.peak_bytes, (long long)counter.count);
+    }
+  }
+  os << "  " << left_justify("total of heap objects", 24)
+     << format("%12lld / %12lld B\n", (long long)total_bytes, (long long)total_peak_bytes);
+
+  std::lock_guard<std::mutex> lock(mtx);
+  os << "Peak of heap objects per phase\n";
+  for (const auto &phase : phase_peaks) {
+    os << "  " << left_justify(phase.first, 24) << format("%12lld B\n", (long long)phase.second);
+  }
+}
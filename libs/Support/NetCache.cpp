@@ -0,0 +1,278 @@
+
+#include "morpheus/Support/NetCache.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LockFileManager.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <sstream>
+
+using namespace llvm;
+
+// -------------------------------------------------------------------------- //
+// utilities
+
+// NOTE: the content is written into a temporary file first and then renamed,
+//       hence other processes sharing the cache never see incomplete files.
+static bool write_atomically(const Twine &path, StringRef content) {
+  int fd;
+  SmallString<128> tmp_path;
+  if (sys::fs::createUniqueFile(path + ".tmp-%%%%%%", fd, tmp_path)) {
+    return false;
+  }
+
+  {
+    raw_fd_ostream os(fd, /* shouldClose */ true);
+    os << content;
+  }
+
+  if (sys::fs::rename(tmp_path, path)) {
+    sys::fs::remove(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+static void touch(const Twine &path) {
+  int fd;
+  if (sys::fs::openFileForWrite(path, fd, sys::fs::CD_OpenExisting, sys::fs::OF_Append)) {
+    return;
+  }
+
+  auto now = std::chrono::time_point_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now());
+  sys::fs::setLastAccessAndModificationTime(fd, now, now);
+  sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+// NOTE: the statistics are shared by all the processes using the cache,
+//       hence their read-modify-write is guarded by a lock file.
+static bool accumulate_stats(StringRef stats_path,
+                             const NetCache::Stats &stats,
+                             NetCache::Stats &overall) {
+  while (true) {
+    LockFileManager lock(stats_path);
+    switch (lock.getState()) {
+      case LockFileManager::LFS_Error:
+        return false;
+      case LockFileManager::LFS_Shared:
+        // the stale lock of a died owner is removed by the next attempt
+        if (lock.waitForUnlock() == LockFileManager::Res_Timeout) {
+          return false;
+        }
+        continue;
+      case LockFileManager::LFS_Owned:
+        break;
+    }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> stored = MemoryBuffer::getFile(stats_path);
+    if (stored) {
+      std::istringstream iss((*stored)->getBuffer().str());
+      iss >> overall.hits >> overall.misses >> overall.evictions;
+    }
+    overall.hits += stats.hits;
+    overall.misses += stats.misses;
+    overall.evictions += stats.evictions;
+
+    std::ostringstream oss;
+    oss << overall.hits << " " << overall.misses << " " << overall.evictions << "\n";
+    return write_atomically(stats_path, oss.str());
+  }
+}
+
+// -------------------------------------------------------------------------- //
+// NetCache
+
+NetCache::NetCache(std::string cache_dir, uint64_t size_limit)
+  : cache_dir(cache_dir), size_limit(size_limit) {
+
+  sys::fs::create_directories(get_objects_dir());
+  sys::fs::create_directories(get_index_dir());
+}
+
+std::string NetCache::get_digest(StringRef content) {
+  MD5 hash;
+  hash.update(content);
+
+  MD5::MD5Result result;
+  hash.final(result);
+  return result.digest().str().str();
+}
+
+std::string NetCache::get_key(StringRef module_digest, unsigned rank, unsigned nproc) {
+  std::ostringstream oss;
+  oss << module_digest.str() << ":" << rank << ":" << nproc << ":" << MORPHEUS_VERSION
+      << ":" << NET_REVISION;
+  return get_digest(oss.str());
+}
+
+bool NetCache::restore(ArrayRef<std::string> keys, StringRef output_dir) {
+  std::vector<Entry> entries;
+  unsigned misses = 0;
+  for (const std::string &key : keys) {
+    Entry entry;
+    if (lookup(key, entry)) {
+      entries.push_back(entry);
+    } else {
+      misses++;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  if (misses > 0) {
+    stats.misses += misses;
+    return false;
+  }
+
+  // NOTE: ranks of a class share the same net, hence it is copied only once
+  std::set<std::string> restored;
+  for (const Entry &entry : entries) {
+    if (!restored.insert(entry.file_name).second) {
+      continue;
+    }
+
+    SmallString<128> path(output_dir);
+    sys::path::append(path, entry.file_name);
+    if (sys::fs::copy_file(entry.object_path, path)) {
+      stats.misses += keys.size();
+      return false;
+    }
+    touch(entry.object_path);
+  }
+
+  stats.hits += keys.size();
+  return true;
+}
+
+void NetCache::store(StringRef key, StringRef net_path) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> net = MemoryBuffer::getFile(net_path);
+  if (!net) {
+    return;
+  }
+
+  std::string object_path = get_object_path(get_digest((*net)->getBuffer()));
+
+  std::lock_guard<std::mutex> lock(mtx);
+  if (sys::fs::exists(object_path)) {
+    touch(object_path);
+  } else if (!write_atomically(object_path, (*net)->getBuffer())) {
+    return;
+  }
+
+  write_atomically(get_index_path(key),
+                   object_path + "\n" + sys::path::filename(net_path).str() + "\n");
+}
+
+void NetCache::evict() {
+  struct Object {
+    std::string path;
+    uint64_t size;
+    sys::TimePoint<> last_used;
+  };
+
+  std::vector<Object> objects;
+  uint64_t total_size = 0;
+
+  std::error_code ec;
+  for (sys::fs::directory_iterator it(get_objects_dir(), ec), end;
+       it != end && !ec;
+       it.increment(ec)) {
+
+    sys::fs::file_status status;
+    if (sys::fs::status(it->path(), status) || !sys::fs::is_regular_file(status)) {
+      continue;
+    }
+    objects.push_back({it->path(), status.getSize(), status.getLastModificationTime()});
+    total_size += status.getSize();
+  }
+
+  if (total_size <= size_limit) {
+    return;
+  }
+
+  std::sort(objects.begin(), objects.end(),
+            [] (const Object &o1, const Object &o2) { return o1.last_used < o2.last_used; });
+
+  // NOTE: index entries pointing to removed objects are treated as misses
+  std::lock_guard<std::mutex> lock(mtx);
+  for (const Object &object : objects) {
+    if (total_size <= size_limit) {
+      break;
+    }
+    if (!sys::fs::remove(object.path)) {
+      total_size -= object.size;
+      stats.evictions++;
+    }
+  }
+}
+
+void NetCache::print_stats(raw_ostream &os) {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  // accumulate the statistics over all the runs
+  SmallString<128> stats_path(cache_dir);
+  sys::path::append(stats_path, "stats");
+
+  Stats overall;
+  if (!accumulate_stats(stats_path, stats, overall)) {
+    os << "MP net cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+       << stats.evictions << " evictions\n";
+    return;
+  }
+
+  os << "MP net cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+     << stats.evictions << " evictions (overall: " << overall.hits << " hits, "
+     << overall.misses << " misses, " << overall.evictions << " evictions)\n";
+}
+
+// private members ---------------------------------------------------------- //
+
+bool NetCache::lookup(StringRef key, Entry &entry) const {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> index = MemoryBuffer::getFile(get_index_path(key));
+  if (!index) {
+    return false;
+  }
+
+  std::istringstream iss((*index)->getBuffer().str());
+  if (!std::getline(iss, entry.object_path) || !std::getline(iss, entry.file_name)) {
+    return false;
+  }
+
+  if (!sys::fs::exists(entry.object_path)) {
+    // the object has been evicted
+    sys::fs::remove(get_index_path(key));
+    return false;
+  }
+  return true;
+}
+
+std::string NetCache::get_objects_dir() const {
+  SmallString<128> path(cache_dir);
+  sys::path::append(path, "objects");
+  return path.str().str();
+}
+
+std::string NetCache::get_index_dir() const {
+  SmallString<128> path(cache_dir);
+  sys::path::append(path, "index");
+  return path.str().str();
+}
+
+std::string NetCache::get_object_path(StringRef digest) const {
+  SmallString<128> path(get_objects_dir());
+  sys::path::append(path, digest);
+  return path.str().str();
+}
+
+std::string NetCache::get_index_path(StringRef key) const {
+  SmallString<128> path(get_index_dir());
+  sys::path::append(path, key);
+  return path.str().str();
+}
@@ -1,17 +1,166 @@
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/PassManager.h"
 
 #include "morpheus/ADT/CommunicationNet.hpp"
 #include "morpheus/ADT/CommNetFactory.hpp"
+#include "morpheus/Analysis/LoopAnalyses.hpp"
 #include "morpheus/Analysis/MPILabellingAnalysis.hpp"
 #include "morpheus/Analysis/MPIScopeAnalysis.hpp"
+#include "morpheus/Analysis/MPISlice.hpp"
 #include "morpheus/Formats/DotGraph.hpp"
+#include "morpheus/Support/Instrumentation.hpp"
 #include "morpheus/Transforms/GenerateMPNet.hpp"
 
 #include <iostream>
+#include <queue>
+#include <vector>
 
 using namespace llvm;
 
+namespace {
+
+  // NOTE: the summary net of an MPI-involved function is built once and
+  //       stored as a subnet of the ACN. All the calls of the function
+  //       refer to it by substitution transitions.
+  class SummaryNets {
+  public:
+    SummaryNets(cn::AddressableCN &acn, MPILabelling &mpi_labelling)
+      : acn(acn), mpi_labelling(mpi_labelling) { }
+
+    // plugs the nets of checkpoints into the basic blocks of the CFG net,
+    // `summary` is the function of the summary net (nullptr for the scope one)
+    void plug_in_checkpoints(cn::CFG_CN &cfg_cn, Function const *summary = nullptr) {
+      for (cn::BasicBlockCN &bbcn : cfg_cn.bb_cns) {
+        // plug-in nets for all MPI calls
+        for (const MPILabelling::MPICheckpoint &checkpoint : mpi_labelling.get_mpi_checkpoints(bbcn.bb)) {
+          if (checkpoint.type == MPICallType::DIRECT) {
+            TimeScope ts("createCommSubnet", bbcn.bb->getName());
+            bbcn.add_pcn(cn::createCommSubnet(checkpoint.cs, checkpoint.kind));
+          } else {
+            Function const *callee = checkpoint.cs.getCalledFunction();
+            if (callee && !callee->isDeclaration()) {
+              bbcn.add_pcn(cn::createCallSubnet(checkpoint.cs, request(callee)));
+              calls.push_back({summary, callee, checkpoint.cs});
+            }
+          }
+        }
+        // enclose the basic block cn
+        bbcn.enclose();
+      }
+    }
+
+    // builds the summary nets of all the requested functions, the summaries
+    // may request other ones (or themselves in case of recursion)
+    void build() {
+      while (!pending.empty()) {
+        Function const *fn = pending.front();
+        pending.pop();
+
+        TimeScope ts("summary_net", fn->getName());
+        LoopAnalyses la(const_cast<Function &>(*fn));
+        MPISlice slice(*fn, la.loop_info, mpi_labelling);
+        ts.add_counter("collapsed_basic_blocks", fn->size() - slice.size());
+
+        cn::CFG_CN cfg_cn(*fn, la.loop_info, &la.se, &slice.get_blocks());
+        plug_in_checkpoints(cfg_cn, fn);
+        cn::CommunicationNet &subnet = acn.add_subnet(fn->getName().str());
+        std::move(cfg_cn).inject_into_subnet(acn, subnet);
+        ts.add_net_counters("after", subnet);
+      }
+    }
+
+    // passes the requests left open by the summary nets into the nets of their
+    // callers, e.g. a request initiated in a wrapper and completed in the scope
+    // function. The callees are processed before their callers so the requests
+    // may be passed through several calls.
+    // NOTE: within a recursion (a cycle of calls) the requests are passed only
+    //       once, the ones unmatched then remain unresolved
+    void pass_requests() {
+      std::vector<Function const *> order;
+      SmallPtrSet<Function const *, 8> visited;
+      for (const Call &call : calls) {
+        if (call.caller == nullptr) {
+          collect_callees_first(call.callee, visited, order);
+        }
+      }
+
+      for (Function const *fn : order) {
+        cn::CommunicationNet &subnet = acn.add_subnet(fn->getName().str());
+        for (const Call &call : calls) {
+          if (call.callee != fn) {
+            continue;
+          }
+          cn::CommunicationNet &caller_cn = call.caller
+            ? acn.add_subnet(call.caller->getName().str())
+            : acn.embedded_cn;
+          subnet.pass_unresolved(caller_cn, [&call](const Value &mpi_rqst) {
+            return get_actual_request(call.cs, mpi_rqst);
+          });
+        }
+        subnet.remove_passed_unresolved([fn](const Value &mpi_rqst) -> Value const * {
+          Argument const *arg = dyn_cast<Argument>(&mpi_rqst);
+          return (arg && arg->getParent() == fn) ? arg : nullptr;
+        });
+      }
+    }
+
+    size_t size() const {
+      return requested.size();
+    }
+
+  private:
+    struct Call {
+      Function const *caller;  // nullptr for the scope function
+      Function const *callee;
+      CallSite cs;
+    };
+
+    // the request given at the call for the formal argument `mpi_rqst`
+    // (nullptr if the request is not an argument of the callee)
+    static Value const *get_actual_request(const CallSite &cs, const Value &mpi_rqst) {
+      Argument const *arg = dyn_cast<Argument>(&mpi_rqst);
+      if (!arg || arg->getParent() != cs.getCalledFunction()) {
+        return nullptr;
+      }
+      // NOTE: the same as for the requests of MPI calls (see CNFactory)
+      Value const *actual = cs.getArgument(arg->getArgNo());
+      if (GetElementPtrInst const *gep = dyn_cast<GetElementPtrInst>(actual)) {
+        actual = gep->getPointerOperand();
+      }
+      return actual;
+    }
+
+    void collect_callees_first(Function const *fn,
+                               SmallPtrSet<Function const *, 8> &visited,
+                               std::vector<Function const *> &order) const {
+      if (!visited.insert(fn).second) {
+        return;
+      }
+      for (const Call &call : calls) {
+        if (call.caller == fn) {
+          collect_callees_first(call.callee, visited, order);
+        }
+      }
+      order.push_back(fn);
+    }
+
+    std::string request(Function const *fn) {
+      if (requested.insert(fn).second) {
+        pending.push(fn);
+      }
+      return fn->getName().str();
+    }
+
+    cn::AddressableCN &acn;
+    MPILabelling &mpi_labelling;
+    SmallPtrSet<Function const *, 8> requested;
+    std::queue<Function const *> pending;
+    std::vector<Call> calls;
+  };
+} // end of anonymous namespace
+
 // -------------------------------------------------------------------------- //
 // GenerateMPNetPass
 
@@ -23,57 +172,109 @@ PreservedAnalyses GenerateMPNetPass::run (Module &m, ModuleAnalysisManager &am)
   ConstantAsMetadata *rank_md = dyn_cast_or_null<ConstantAsMetadata>(
     m.getModuleFlag("morpheus.pruned_rank"));
 
-  std::unique_ptr<cn::AddressableCN> acn;
+  std::string address;
   if (rank_md == nullptr) {
-    acn = std::make_unique<cn::AddressableCN>("global");
+    address = "global";
   } else {
     ConstantInt *rank_v = dyn_cast<ConstantInt>(rank_md->getValue());
     auto rank = rank_v->getValue().getLimitedValue();
-    acn = std::make_unique<cn::AddressableCN>("rank=" + std::to_string(rank));
+    address = "rank=" + std::to_string(rank);
   }
 
   MPIScope &mpi_scope = am.getResult<MPIScopeAnalysis>(m);
+  MPILabelling &mpi_labelling = am.getResult<MPILabellingAnalysis>(m);
+
+  std::unique_ptr<cn::AddressableCN> acn = generate(address, mpi_scope, mpi_labelling);
+
+  std::cout << get_file_name(m, *acn) << std::endl;
+  {
+    TimeScope ts("format_dot");
+    std::cout << *acn;
+  }
+
+  return PreservedAnalyses::all();
+}
+
+std::unique_ptr<cn::AddressableCN>
+GenerateMPNetPass::generate(std::string address,
+                            MPIScope &mpi_scope,
+                            MPILabelling &mpi_labelling) {
+
+  // the IDs (and so the output) of the net do not depend on the other nets
+  cn::Identifiable::reset_ids();
+  auto acn = std::make_unique<cn::AddressableCN>(address);
 
   if (!mpi_scope.isValid()) {
     acn->clear();
     cn::Place &p = acn->add_place("", "", "No MPI scope!");
     p.highlight_color = "#aacccc";
   } else {
-    MPILabelling &mpi_labelling = am.getResult<MPILabellingAnalysis>(m);
-
     Function *scope_fn = mpi_scope.getFunction();
-    LoopInfo &loop_info = *mpi_scope.getLoopInfo();
+    LoopAnalyses la(*scope_fn);
+
+    // only the blocks relevant for communication become BasicBlockCNs
+    TimeScope slice_ts("mpi_slice", scope_fn->getName());
+    MPISlice slice(*scope_fn, la.loop_info, mpi_labelling);
+    slice_ts.add_counter("basic_blocks", scope_fn->size());
+    slice_ts.add_counter("collapsed_basic_blocks", scope_fn->size() - slice.size());
+    slice_ts.stop();
 
     // create the CN representing scope function and following the CFG structure
-    cn::CFG_CN cfg_cn(*scope_fn, loop_info);
+    TimeScope cfg_ts("CFG_CN", scope_fn->getName());
+    cn::CFG_CN cfg_cn(*scope_fn, la.loop_info, &la.se, &slice.get_blocks());
+    cfg_ts.add_net_counters("after", cfg_cn);
+    cfg_ts.add_memory_counters(cfg_cn);
+    cfg_ts.add_counter("basic_blocks", cfg_cn.bb_cns.size());
+    cfg_ts.stop();
 
     // for each basic block in CFG_CN add a pcn if possible
-    for (cn::BasicBlockCN &bbcn : cfg_cn.bb_cns) {
-      // plug-in nets for all MPI calls
-      MPILabelling::MPICheckpoints checkpoints = mpi_labelling.get_mpi_checkpoints(bbcn.bb);
-      while (!checkpoints.empty()) {
-        auto checkpoint = checkpoints.front();
-        if (checkpoint.second == MPICallType::DIRECT) {
-          bbcn.add_pcn(cn::createCommSubnet(checkpoint.first));
-        } else {
-          // TODO: implement reaction on other types of checkpoints
-        }
-        checkpoints.pop();
-      }
-      // enclose the basic block cn
-      bbcn.enclose();
+    SummaryNets summaries(*acn, mpi_labelling);
+    summaries.plug_in_checkpoints(cfg_cn);
+
+    {
+      TimeScope ts("inject_into");
+      ts.add_net_counters("before", *acn);
+      std::move(cfg_cn).inject_into(*acn);
+      ts.add_net_counters("after", *acn);
+      ts.add_memory_counters(*acn);
     }
 
-    std::move(cfg_cn).inject_into(*acn);
+    {
+      TimeScope ts("summary_nets");
+      summaries.build();
+      ts.add_counter("functions", summaries.size());
+      ts.add_net_counters("after", *acn);
+    }
+    summaries.pass_requests();
 
     // resolve unresolved elements
-    acn->embedded_cn.resolve_unresolved();
+    {
+      TimeScope ts("resolve_unresolved");
+      ts.add_net_counters("before", *acn);
+      acn->resolve_unresolved();
+      ts.add_net_counters("after", *acn);
+      ts.add_memory_counters(*acn);
+    }
     // enclose the cn
     acn->enclose();
 
-    acn->collapse();
+    {
+      TimeScope ts("collapse");
+      ts.add_net_counters("before", *acn);
+      acn->collapse();
+      ts.add_net_counters("after", *acn);
+      ts.add_memory_counters(*acn);
+    }
   }
 
+  return acn;
+}
+
+std::string GenerateMPNetPass::get_file_name(const Module &m, const cn::AddressableCN &acn) {
+  return get_file_name(m, acn.address);
+}
+
+std::string GenerateMPNetPass::get_file_name(const Module &m, const std::string &suffix) {
   string name = m.getSourceFileName();
   unsigned slash_pos = name.find_last_of("/");
   unsigned dot_pos = name.find_last_of(".");
@@ -82,10 +283,5 @@ PreservedAnalyses GenerateMPNetPass::run (Module &m, ModuleAnalysisManager &am)
     name = name.substr(slash_pos + 1, count);
   }
 
-  std::cout << name + "-" + acn->address + ".dot" << std::endl;
-  std::cout << *acn;
-
-  return PreservedAnalyses::all();
+  return name + "-" + suffix + ".dot";
 }
-
-
@@ -0,0 +1,518 @@
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "morpheus/ADT/CommunicationNet.hpp"
+#include "morpheus/Analysis/LoopAnalyses.hpp"
+#include "morpheus/Analysis/MPILabellingAnalysis.hpp"
+#include "morpheus/Analysis/MPIScopeAnalysis.hpp"
+#include "morpheus/Analysis/RankPredicates.hpp"
+#include "morpheus/Formats/DotGraph.hpp"
+#include "morpheus/Support/Instrumentation.hpp"
+#include "morpheus/Support/NetCache.hpp"
+#include "morpheus/Transforms/GenerateMPNet.hpp"
+#include "morpheus/Transforms/GenerateMPNetAll.hpp"
+#include "morpheus/Transforms/MorpheusPrepare.hpp"
+#include "morpheus/Transforms/MPISubstituteRank.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+using namespace llvm;
+
+namespace {
+
+  // A complete set of analysis managers used to run passes outside of opt.
+  struct AnalysisManagers {
+    // NOTE: the pass builder has to outlive the managers as the registered
+    //       analyses may refer to it.
+    PassBuilder pb;
+    LoopAnalysisManager lam;
+    FunctionAnalysisManager fam;
+    CGSCCAnalysisManager cgam;
+    ModuleAnalysisManager mam;
+
+    AnalysisManagers() {
+      pb.registerModuleAnalyses(mam);
+      pb.registerCGSCCAnalyses(cgam);
+      pb.registerFunctionAnalyses(fam);
+      pb.registerLoopAnalyses(lam);
+      pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+      mam.registerPass([] { return MPILabellingAnalysis(); });
+      mam.registerPass([] { return MPIScopeAnalysis(); });
+    }
+  };
+
+  // NOTE: the pruning of `morpheus-prepare` pipeline (see MorpheusPrepare)
+  //       that propagates the substituted rank and size and removes the
+  //       blocks unreachable for the rank.
+  void cleanup(Module &m) {
+    AnalysisManagers ams;
+
+    ModulePassManager mpm;
+    add_prune_passes(mpm);
+    mpm.run(m, ams.mam);
+  }
+
+  // ------------------------------------------------------------------------ //
+  // Fingerprint of the rank-pruned scope function. It covers everything the
+  // MP net is built of: the CFG, the bounds of loops and the operands of the
+  // MPI calls, together with the called MPI-involved functions (their
+  // summary nets).
+
+  // NOTE: the fingerprint is the MD5 digest of a canonical serialization,
+  //       hence the ranks of different nets do not share a class unless
+  //       the digests collide.
+  class Fingerprint {
+  public:
+    static std::string compute(MPIScope &mpi_scope, const MPILabelling &mpi_labelling) {
+      Fingerprint fp;
+      if (mpi_scope.isValid()) {
+        fp.request(mpi_scope.getFunction());
+        for (size_t idx = 0; idx < fp.functions.size(); idx++) {
+          const Function &fn = *fp.functions[idx];
+          fp.os << "function " << fn.getName() << "\n";
+          fp.serialize_function(fn, mpi_labelling);
+        }
+      }
+      return NetCache::get_digest(fp.os.str());
+    }
+
+  private:
+    std::string str;
+    raw_string_ostream os{str};
+
+    // functions in the order of their first calls, each one is serialized once
+    std::vector<Function const *> functions;
+    SmallPtrSet<Function const *, 8> requested;
+
+    void request(Function const *fn) {
+      if (requested.insert(fn).second) {
+        functions.push_back(fn);
+      }
+    }
+
+    // NOTE: the values of different clones (contexts) cannot be compared
+    //       directly, hence they are replaced by the order of appearance.
+    DenseMap<Value const *, unsigned> numbering;
+
+    unsigned number(Value const *v) {
+      return numbering.insert({v, numbering.size()}).first->second;
+    }
+
+    void serialize_function(const Function &fn, const MPILabelling &mpi_labelling) {
+      for (const BasicBlock &bb : fn) {
+        number(&bb);
+      }
+
+      for (const BasicBlock &bb : fn) {
+        os << "block " << number(&bb) << " ->";
+        for (const BasicBlock *succ : successors(&bb)) {
+          os << " " << number(succ);
+        }
+        os << "\n";
+
+        for (const MPILabelling::MPICheckpoint &checkpoint : mpi_labelling.get_mpi_checkpoints(&bb)) {
+          const CallSite &cs = checkpoint.cs;
+          os << "  checkpoint " << unsigned(checkpoint.type) << " " << unsigned(checkpoint.kind);
+          if (checkpoint.kind == MPICallKind::OTHER || checkpoint.kind == MPICallKind::NONE) {
+            os << " " << cs.getCalledFunction()->getName();
+          }
+          if (checkpoint.type == MPICallType::INDIRECT &&
+              !cs.getCalledFunction()->isDeclaration()) {
+            request(cs.getCalledFunction());
+          }
+          for (const Value *arg : cs.args()) {
+            os << " ";
+            serialize_operand(arg);
+          }
+          os << "\n";
+        }
+      }
+
+      // NOTE: the loop headers are annotated by the bounds (see CFG_CN),
+      //       e.g. the ranks may differ only in the number of iterations
+      LoopAnalyses las(const_cast<Function &>(fn));
+      for (const Loop *loop : las.loop_info.getLoopsInPreorder()) {
+        os << "loop " << number(loop->getHeader()) << " "
+           << get_loop_bounds(las.se, *loop) << "\n";
+      }
+    }
+
+    void serialize_operand(Value const *v) {
+      if (isa<Constant>(v)) {
+        v->printAsOperand(os, true);
+        return;
+      }
+
+      // NOTE: requests stored within an array are identified by the array
+      if (GetElementPtrInst const *gep = dyn_cast<GetElementPtrInst>(v)) {
+        os << "gep(";
+        for (const Use &op : gep->operands()) {
+          if (op.getOperandNo()) {
+            os << ", ";
+          }
+          serialize_operand(op.get());
+        }
+        os << ")";
+        return;
+      }
+
+      os << "%" << number(v) << ":" << *v->getType();
+    }
+  };
+
+  // ------------------------------------------------------------------------ //
+  // A module pruned for a particular rank together with its analyses.
+
+  struct PrunedModule {
+    // NOTE: the module is declared first to be destroyed as the last one
+    std::unique_ptr<Module> m;
+    MPILabelling mpi_labelling;
+    MPIScope mpi_scope;
+    std::string fingerprint;
+  };
+
+  // the calls of the kind within the clone of the module
+  std::vector<Instruction *> get_cloned_calls(const MPILabelling &mpi_labelling,
+                                              MPICallKind kind,
+                                              ValueToValueMapTy &vmap) {
+    std::vector<Instruction *> calls;
+    for (Instruction *call : mpi_labelling.get_calls(kind)) {
+      calls.push_back(cast<Instruction>(vmap[call]));
+    }
+    return calls;
+  }
+
+  // clones the module, specializes the clone (e.g. substitutes the rank)
+  // and prunes it
+  PrunedModule prune(const Module &m,
+                     const MPILabelling &mpi_labelling,
+                     const MPIScope &mpi_scope,
+                     const std::string &detail,
+                     function_ref<void(Module &, ValueToValueMapTy &)> specialize) {
+    TimeScope ts("prune", detail);
+
+    ValueToValueMapTy vmap;
+    std::unique_ptr<Module> pruned_m = CloneModule(m, vmap);
+
+    specialize(*pruned_m, vmap);
+    {
+      TimeScope cleanup_ts("cleanup", detail);
+      cleanup(*pruned_m);
+    }
+
+    PrunedModule pruned{std::move(pruned_m),
+                        MPILabelling(mpi_labelling, vmap),
+                        MPIScope(mpi_scope, vmap),
+                        std::string()};
+    pruned.fingerprint = Fingerprint::compute(pruned.mpi_scope, pruned.mpi_labelling);
+    return pruned;
+  }
+
+  PrunedModule prune(const Module &m,
+                     const MPILabelling &mpi_labelling,
+                     const MPIScope &mpi_scope,
+                     unsigned rank,
+                     unsigned nproc) {
+    return prune(m, mpi_labelling, mpi_scope, "rank=" + std::to_string(rank),
+                 [&] (Module &rank_m, ValueToValueMapTy &vmap) {
+      MPISubstituteRankPass::substitute(
+        rank_m, get_cloned_calls(mpi_labelling, MPICallKind::COMM_RANK, vmap), rank);
+      MPISubstituteRankPass::substitute_size(
+        rank_m, get_cloned_calls(mpi_labelling, MPICallKind::COMM_SIZE, vmap), nproc);
+    });
+  }
+
+  // ------------------------------------------------------------------------ //
+  // Ranks with the same fingerprint form an equivalence class that shares
+  // a single MP net.
+
+  class RankClasses {
+  public:
+    // returns true if the rank is the first one registered within its class
+    bool add(const std::string &fingerprint, unsigned rank) {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::vector<unsigned> &ranks = classes[fingerprint];
+      ranks.push_back(rank);
+      return ranks.size() == 1;
+    }
+
+    std::vector<unsigned> get_ranks(const std::string &fingerprint) {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::vector<unsigned> ranks = classes[fingerprint];
+      std::sort(ranks.begin(), ranks.end());
+      return ranks;
+    }
+
+    // the address lists the ranks of the class, e.g.: rank=0,2..4
+    std::string get_address(const std::string &fingerprint) {
+      std::vector<unsigned> ranks = get_ranks(fingerprint);
+
+      std::vector<std::string> intervals;
+      auto it = ranks.begin();
+      while (it != ranks.end()) {
+        auto last = it;
+        while (std::next(last) != ranks.end() && *std::next(last) == *last + 1) {
+          last++;
+        }
+
+        if (it == last) {
+          intervals.push_back(std::to_string(*it));
+        } else {
+          intervals.push_back(std::to_string(*it) + ".." + std::to_string(*last));
+        }
+        it = std::next(last);
+      }
+      return "rank=" + Utils::pp_vector(intervals);
+    }
+
+  private:
+    std::mutex mtx;
+    std::map<std::string, std::vector<unsigned>> classes;
+  };
+
+  // returns the path of the stored net, or an empty string on failure
+  std::string store_net(PrunedModule &pruned,
+                        const std::string &address,
+                        const std::string &file_suffix,
+                        StringRef output_dir) {
+    TimeScope ts("generate", address);
+    std::unique_ptr<cn::AddressableCN> acn = GenerateMPNetPass::generate(
+      address, pruned.mpi_scope, pruned.mpi_labelling);
+
+    SmallString<128> path(output_dir);
+    sys::path::append(path, GenerateMPNetPass::get_file_name(*pruned.m, file_suffix));
+
+    std::ofstream out(path.c_str());
+    if (!out) {
+      errs() << "Cannot write the MP net to '" << path << "'.\n";
+      return "";
+    }
+    TimeScope format_ts("format_dot", address);
+    out << *acn;
+    return path.str().str();
+  }
+
+  // ------------------------------------------------------------------------ //
+  // Rank-symbolic generation. The ranks are partitioned by the outcomes of
+  // rank predicates guarding the checkpoints (see RankPredicates) and a net
+  // is generated once per class. The clone of a class has the predicates
+  // replaced by their outcomes, while the rank itself stays symbolic.
+  // The predicate is the address of the net, the file is named by the index
+  // of the class (e.g. ring-class0.dot) as the predicate may be arbitrarily
+  // long and its characters (e.g. < and >) do not fit into file names.
+
+  void generate_symbolic(const Module &m,
+                         const MPILabelling &mpi_labelling,
+                         const MPIScope &mpi_scope,
+                         const std::vector<unsigned> &ranks,
+                         unsigned nproc,
+                         StringRef output_dir) {
+    std::unique_ptr<RankPredicates> predicates;
+    std::map<RankPredicates::Outcomes, unsigned> classes; // outcomes -> number of ranks
+    {
+      TimeScope ts("rank_classes");
+      predicates = std::make_unique<RankPredicates>(m, mpi_labelling, nproc, ranks);
+      for (unsigned rank : ranks) {
+        classes[predicates->evaluate(rank)]++;
+      }
+      ts.add_counter("predicates", predicates->get_branches().size());
+      ts.add_counter("classes", classes.size());
+    }
+
+    unsigned class_idx = 0;
+    for (const auto &rank_class : classes) {
+      const RankPredicates::Outcomes &outcomes = rank_class.first;
+      std::string address = predicates->describe(outcomes);
+
+      PrunedModule pruned = prune(m, mpi_labelling, mpi_scope, address,
+                                  [&] (Module &class_m, ValueToValueMapTy &vmap) {
+        const std::vector<BranchInst *> &branches = predicates->get_branches();
+        for (size_t idx = 0; idx < branches.size(); idx++) {
+          BranchInst *branch = cast<BranchInst>(vmap[branches[idx]]);
+          branch->setCondition(ConstantInt::getBool(class_m.getContext(), outcomes[idx]));
+        }
+        MPISubstituteRankPass::substitute_size(
+          class_m, get_cloned_calls(mpi_labelling, MPICallKind::COMM_SIZE, vmap), nproc);
+      });
+      store_net(pruned, address, "class" + std::to_string(class_idx++), output_dir);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+// GenerateMPNetAllPass
+
+PreservedAnalyses GenerateMPNetAllPass::run (Module &m, ModuleAnalysisManager &am) {
+
+  const unsigned nproc = opts.nproc;
+  std::vector<unsigned> ranks = opts.ranks;
+  if (ranks.empty()) {
+    for (unsigned rank = 0; rank < nproc; rank++) {
+      ranks.push_back(rank);
+    }
+  }
+  for (unsigned rank : ranks) {
+    if (rank >= nproc) {
+      report_fatal_error("generate-mpn-all: the rank " + Twine(rank) +
+                         " is out of the range of " + Twine(nproc) + " processes.");
+    }
+  }
+  const unsigned jobs = std::min<unsigned>(opts.jobs, ranks.size());
+  const StringRef output_dir = opts.output_dir;
+
+  // NOTE: the classes of the symbolic mode are few, hence they are generated
+  //       sequentially and not cached
+  if (opts.symbolic_rank) {
+    am.registerPass([] { return MPILabellingAnalysis(); });
+    am.registerPass([] { return MPIScopeAnalysis(); });
+
+    generate_symbolic(m, am.getResult<MPILabellingAnalysis>(m), am.getResult<MPIScopeAnalysis>(m),
+                      ranks, nproc, output_dir);
+    return PreservedAnalyses::all();
+  }
+
+  // NOTE: the bitcode serves both as a key into the cache and as a copy
+  //       of the module passed to parallel workers. The driver may give
+  //       the key instead, so it can restore the nets without running opt.
+  SmallVector<char, 0> bitcode;
+  if (jobs > 1 || (!opts.cache_dir.empty() && opts.source_digest.empty())) {
+    raw_svector_ostream bitcode_os(bitcode);
+    WriteBitcodeToFile(m, bitcode_os);
+  }
+
+  std::unique_ptr<NetCache> cache;
+  std::vector<std::string> cache_keys(nproc);
+  if (!opts.cache_dir.empty()) {
+    cache = std::make_unique<NetCache>(opts.cache_dir, opts.cache_size_limit);
+
+    std::string digest = opts.source_digest.empty()
+      ? NetCache::get_digest(StringRef(bitcode.data(), bitcode.size()))
+      : opts.source_digest;
+    std::vector<std::string> keys;
+    for (unsigned rank : ranks) {
+      cache_keys[rank] = NetCache::get_key(digest, rank, nproc);
+      keys.push_back(cache_keys[rank]);
+    }
+
+    if (cache->restore(keys, output_dir)) {
+      cache->print_stats(errs());
+      return PreservedAnalyses::all();
+    }
+  }
+
+  // NOTE: the generation runs in two phases. First, each rank is pruned and
+  //       its fingerprint is computed. Then, the MP net is generated only for
+  //       the first rank of each class, the other ones are dropped right away.
+  RankClasses classes;
+
+  auto store = [&] (PrunedModule &pruned) {
+    std::string address = classes.get_address(pruned.fingerprint);
+    std::string path = store_net(pruned, address, address, output_dir);
+    if (cache && !path.empty()) {
+      for (unsigned rank : classes.get_ranks(pruned.fingerprint)) {
+        cache->store(cache_keys[rank], path);
+      }
+    }
+  };
+
+  if (jobs <= 1) {
+    am.registerPass([] { return MPILabellingAnalysis(); });
+    am.registerPass([] { return MPIScopeAnalysis(); });
+
+    // NOTE: the analyses (and so the call graph) are computed only once
+    //       for the original module, the clones only take them over.
+    MPILabelling &mpi_labelling = am.getResult<MPILabellingAnalysis>(m);
+    MPIScope &mpi_scope = am.getResult<MPIScopeAnalysis>(m);
+
+    std::vector<PrunedModule> representatives;
+    for (unsigned rank : ranks) {
+      PrunedModule pruned = prune(m, mpi_labelling, mpi_scope, rank, nproc);
+      if (classes.add(pruned.fingerprint, rank)) {
+        representatives.push_back(std::move(pruned));
+      }
+    }
+
+    for (PrunedModule &pruned : representatives) {
+      store(pruned);
+    }
+  } else {
+    // NOTE: LLVMContext is not thread-safe, therefore each worker owns its
+    //       context with a copy of the module (passed via in-memory bitcode).
+    //       The analyses are computed once per worker, and the ranks are
+    //       distributed dynamically among the workers.
+    struct Worker {
+      LLVMContext ctx;
+      std::unique_ptr<Module> m;
+      std::vector<PrunedModule> representatives;
+    };
+
+    std::vector<Worker> workers(jobs);
+    std::atomic<unsigned> next_rank(0);
+
+    auto prune_ranks = [&] (Worker &worker) {
+      Expected<std::unique_ptr<Module>> worker_m = parseBitcodeFile(
+        MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()), m.getModuleIdentifier()),
+        worker.ctx);
+      if (!worker_m) {
+        logAllUnhandledErrors(worker_m.takeError(), errs(), "generate-mpn-all: ");
+        return;
+      }
+      worker.m = std::move(*worker_m);
+
+      AnalysisManagers ams;
+      MPILabelling &mpi_labelling = ams.mam.getResult<MPILabellingAnalysis>(*worker.m);
+      MPIScope &mpi_scope = ams.mam.getResult<MPIScopeAnalysis>(*worker.m);
+
+      for (unsigned i = next_rank++; i < ranks.size(); i = next_rank++) {
+        unsigned rank = ranks[i];
+        PrunedModule pruned = prune(*worker.m, mpi_labelling, mpi_scope, rank, nproc);
+        if (classes.add(pruned.fingerprint, rank)) {
+          worker.representatives.push_back(std::move(pruned));
+        }
+      }
+    };
+
+    auto store_nets = [&] (Worker &worker) {
+      for (PrunedModule &pruned : worker.representatives) {
+        store(pruned);
+      }
+    };
+
+    // NOTE: the classes are complete only when all the ranks are pruned,
+    //       hence the nets are generated after all the workers finish.
+    ThreadPool pool(jobs);
+    for (Worker &worker : workers) {
+      pool.async(prune_ranks, std::ref(worker));
+    }
+    pool.wait();
+
+    for (Worker &worker : workers) {
+      pool.async(store_nets, std::ref(worker));
+    }
+    pool.wait();
+  }
+
+  if (cache) {
+    cache->evict();
+    cache->print_stats(errs());
+  }
+
+  return PreservedAnalyses::all();
+}
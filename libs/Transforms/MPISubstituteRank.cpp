@@ -1,5 +1,5 @@
+
 #include "llvm/IR/IRBuilder.h"
-#include "llvm/Support/CommandLine.h"
 
 #include "morpheus/Analysis/MPILabellingAnalysis.hpp"
 #include "morpheus/Transforms/MPISubstituteRank.hpp"
@@ -8,42 +8,69 @@
 
 using namespace llvm;
 
+namespace {
+  // replaces all the loads of the output argument of the call by the constant
+  void replace_output_loads(Instruction *call, unsigned arg_idx, unsigned value) {
+    CallSite cs(call);
+    Value *output = cs.getArgument(arg_idx);
+
+    IRBuilder<> builder(call);
+    ConstantInt *const_value = builder.getInt32(value);
+
+    // NOTE: copy users to avoid iterator invalidation during replaces
+    std::vector<User *> users;
+    std::copy(output->user_begin(), output->user_end(), std::back_inserter(users));
+
+    for (auto *user : users) {
+      if (isa<LoadInst>(user)) {
+        // replace all loads from the output by const value
+        user->replaceAllUsesWith(const_value);
+      }
+    }
+  }
+} // end of anonymous namespace
+
 // -------------------------------------------------------------------------- //
 // MPISubstitueRankPass
 
-static cl::opt<unsigned> rank_arg(
-    "rank", cl::Required, cl::Hidden,
-    cl::desc("An unsigned integer specifying rank of interest."));
-
 PreservedAnalyses MPISubstituteRankPass::run (Module &m, ModuleAnalysisManager &am) {
 
   am.registerPass([] { return MPILabellingAnalysis(); });
 
   MPILabelling &mpi_labelling = am.getResult<MPILabellingAnalysis>(m);
 
-  std::vector<Instruction *> comm_ranks = mpi_labelling.get_calls("MPI_Comm_rank");
+  substitute(m, mpi_labelling.get_calls(MPICallKind::COMM_RANK), rank);
+  if (nproc) {
+    substitute_size(m, mpi_labelling.get_calls(MPICallKind::COMM_SIZE), *nproc);
+  }
+
+  return PreservedAnalyses::none();
+}
+
+void MPISubstituteRankPass::substitute(Module &m,
+                                       const std::vector<Instruction *> &comm_ranks,
+                                       unsigned rank) {
 
   // replace all usages of rank by constant value
   for (Instruction *comm_rank : comm_ranks) {
-    CallSite cs_comm_rank(comm_rank);
-    Value *rank_val = cs_comm_rank.getArgument(1);
+    replace_output_loads(comm_rank, 1, rank);
+  }
 
-    IRBuilder<> builder(comm_rank);
-    ConstantInt *const_rank = builder.getInt32(rank_arg);
+  m.addModuleFlag(Module::Warning, "morpheus.pruned_rank", uint32_t(rank));
+}
 
-    // NOTE: copy users to avoid iterator invalidation during replaces
-    std::vector<User *> users;
-    std::copy(rank_val->user_begin(), rank_val->user_end(), std::back_inserter(users));
+void MPISubstituteRankPass::substitute_size(Module &m,
+                                            const std::vector<Instruction *> &comm_sizes,
+                                            unsigned nproc) {
 
-    for (auto *user : users) {
-      if (isa<LoadInst>(user)) {
-        // replace all loads from rank by const value
-        user->replaceAllUsesWith(const_rank);
-      }
+  // NOTE: the constant size enables folding of loop bounds, sizes of request
+  //       arrays, etc. by the subsequent constant propagation. Only the size
+  //       of MPI_COMM_WORLD is the number of processes.
+  for (Instruction *comm_size : comm_sizes) {
+    if (is_comm_world(CallSite(comm_size).getArgument(0))) {
+      replace_output_loads(comm_size, 1, nproc);
     }
   }
 
-  m.addModuleFlag(Module::Warning, "morpheus.pruned_rank", uint32_t(rank_arg));
-
-  return PreservedAnalyses::none();
+  m.addModuleFlag(Module::Warning, "morpheus.comm_size", uint32_t(nproc));
 }
@@ -0,0 +1,37 @@
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/Transforms/IPO/SCCP.h"
+#include "llvm/Transforms/Scalar/ADCE.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+
+#include "morpheus/Transforms/MorpheusPrepare.hpp"
+
+using namespace llvm;
+
+// -------------------------------------------------------------------------- //
+// MorpheusPrepare
+
+void llvm::add_prepare_passes(ModulePassManager &mpm) {
+  // NOTE: the allocas escaping to MPI calls (e.g. the output of MPI_Comm_rank)
+  //       are kept, hence their loads can be substituted afterwards.
+  FunctionPassManager fpm;
+  fpm.addPass(SROA());
+  mpm.addPass(createModuleToFunctionPassAdaptor(std::move(fpm)));
+}
+
+void llvm::add_prune_passes(ModulePassManager &mpm) {
+  // promote the values loaded from the substituted outputs
+  FunctionPassManager promote_fpm;
+  promote_fpm.addPass(SROA());
+  mpm.addPass(createModuleToFunctionPassAdaptor(std::move(promote_fpm)));
+
+  // NOTE: IPSCCP propagates the constants into the internal functions and
+  //       through globals, the branches it folds leave the blocks dead.
+  mpm.addPass(IPSCCPPass());
+
+  FunctionPassManager prune_fpm;
+  prune_fpm.addPass(ADCEPass());
+  prune_fpm.addPass(SimplifyCFGPass());
+  mpm.addPass(createModuleToFunctionPassAdaptor(std::move(prune_fpm)));
+}
@@ -1,35 +1,168 @@
-
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
-#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 
+#include "morpheus/Support/Instrumentation.hpp"
+#include "morpheus/Transforms/MorpheusPrepare.hpp"
 #include "morpheus/Transforms/MPISubstituteRank.hpp"
 #include "morpheus/Transforms/GenerateMPNet.hpp"
+#include "morpheus/Transforms/GenerateMPNetAll.hpp"
 
 using namespace llvm;
 
+// NOTE: options are processed only if the plugin is loaded
+//       by old PM as well (`--load`).
+static cl::opt<unsigned> rank_arg(
+    "rank", cl::Hidden,
+    cl::desc("An unsigned integer specifying rank of interest."));
+
+static cl::opt<unsigned> nproc_arg(
+    "nproc", cl::init(1), cl::Hidden,
+    cl::desc("An unsigned integer specifying the number of processes."));
+
+static cl::opt<std::string> output_dir_arg(
+    "mpn-output-dir", cl::init("."), cl::Hidden,
+    cl::desc("A directory where the generated MP nets are stored."));
+
+static cl::opt<unsigned> jobs_arg(
+    "mpn-jobs", cl::init(1), cl::Hidden,
+    cl::desc("A number of workers generating the MP nets of ranks in parallel."));
+
+static cl::opt<std::string> cache_dir_arg(
+    "mpn-cache-dir", cl::init(""), cl::Hidden,
+    cl::desc("A directory of the cache of MP nets (disabled if not set)."));
+
+static cl::opt<unsigned> cache_size_arg(
+    "mpn-cache-size", cl::init(512), cl::Hidden,
+    cl::desc("A size limit of the cache of MP nets in MiB."));
+
+static cl::opt<std::string> cache_source_digest_arg(
+    "mpn-cache-source-digest", cl::init(""), cl::Hidden,
+    cl::desc("A digest of the preprocessed sources used as a key into the cache "
+             "instead of the digest of the module (computed by the driver)."));
+
+static cl::opt<std::string> source_name_arg(
+    "mpn-source-name", cl::init(""), cl::Hidden,
+    cl::desc("A source file name of the module used to name the MP nets."));
+
+static cl::opt<bool> symbolic_rank_arg(
+    "mpn-symbolic-rank", cl::init(false), cl::Hidden,
+    cl::desc("Generate a single MP net per class of ranks given by rank predicates."));
+
+static cl::opt<std::string> time_trace_arg(
+    "morpheus-time-trace", cl::init(""), cl::Hidden,
+    cl::desc("A file where the Chrome trace of phases of MP net generation is "
+             "stored (the summary goes to <file>.summary.json)."));
+
+static cl::opt<bool> memory_stats_arg(
+    "morpheus-memory-stats", cl::init(false), cl::Hidden,
+    cl::desc("Account the memory of nets and analyses and print a report."));
+
+namespace {
+  // NOTE: a module linked from several translation units (llvm-link) carries
+  //       a generic source file name, hence it can be overridden.
+  struct SetSourceFileNamePass : public PassInfoMixin<SetSourceFileNamePass> {
+    SetSourceFileNamePass(std::string source_name) : source_name(source_name) { }
+
+    PreservedAnalyses run(Module &m, ModuleAnalysisManager &) {
+      m.setSourceFileName(source_name);
+      return PreservedAnalyses::all();
+    }
+
+    std::string source_name;
+  };
+
+  // NOTE: it is added at the end of a pipeline, hence the trace and
+  //       the memory report cover all the preceding passes.
+  struct ReportInstrumentationPass : public PassInfoMixin<ReportInstrumentationPass> {
+    PreservedAnalyses run(Module &, ModuleAnalysisManager &) {
+      if (!time_trace_arg.empty()) {
+        Instrumentation::get().write(time_trace_arg);
+      }
+      if (memory_stats_arg) {
+        MemoryAccounting::get().print_report(errs());
+      }
+      return PreservedAnalyses::all();
+    }
+  };
+}
+
 // The possibility to call pass via opt
 extern "C" ::llvm::PassPluginLibraryInfo LLVM_ATTRIBUTE_WEAK
 
 llvmGetPassPluginInfo() {
   return {
-    LLVM_PLUGIN_API_VERSION, "Morph", "v0.1", // TODO: expose version
+    LLVM_PLUGIN_API_VERSION, "Morph", "v" MORPHEUS_VERSION,
       [](PassBuilder &PB) {
       PB.registerPipelineParsingCallback(
         [](StringRef PassName, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) {
-          if (PassName.startswith("substituterank")) {
+          if (!time_trace_arg.empty()) {
+            Instrumentation::get().enable();
+          }
+          if (memory_stats_arg) {
+            MemoryAccounting::get().enable();
+          }
+          bool report = !time_trace_arg.empty() || memory_stats_arg;
+
+          if (PassName.startswith("substituterank") || PassName == "morpheus-prepare") {
           // if (PassName == "pruneprocess") {
+            if (rank_arg.getNumOccurrences() == 0) {
+              report_fatal_error(PassName + ": the rank has to be specified (-rank).");
+            }
+            // NOTE: the size of communicator is substituted only if it is given
+            std::optional<unsigned> nproc;
+            if (nproc_arg.getNumOccurrences() > 0) {
+              if (rank_arg >= nproc_arg) {
+                report_fatal_error(PassName + ": the rank " + Twine(rank_arg) +
+                                   " is out of the range of " + Twine(nproc_arg) + " processes.");
+              }
+              nproc = nproc_arg;
+            }
+
+            // NOTE: `morpheus-prepare` substitutes the rank and prunes the module
+            //       in-process, hence no separate `opt -mem2reg ...` is needed.
+            bool prepare = PassName == "morpheus-prepare";
+            if (prepare) {
+              add_prepare_passes(MPM);
+            }
             // NOTE: the standard passes are already registered
             //       so I just add them, if needed.
             MPM.addPass(RequireAnalysisPass<CallGraphAnalysis, Module>());
-            MPM.addPass(RequireAnalysisPass<ModuleSummaryIndexAnalysis, Module>());
-            MPM.addPass(MPISubstituteRankPass());
+            MPM.addPass(MPISubstituteRankPass(rank_arg, nproc));
+            if (prepare) {
+              add_prune_passes(MPM);
+            }
           }
 
-          if (PassName.startswith("generate-mpn")) {
+          // NOTE: it has to be checked before `generate-mpn` as it shares the prefix
+          if (PassName == "generate-mpn-all") {
+            if (!source_name_arg.empty()) {
+              MPM.addPass(SetSourceFileNamePass(source_name_arg));
+            }
+            add_prepare_passes(MPM);
+            MPM.addPass(RequireAnalysisPass<CallGraphAnalysis, Module>());
+            GenerateMPNetAllOptions opts;
+            opts.nproc = nproc_arg;
+            opts.output_dir = output_dir_arg;
+            opts.jobs = jobs_arg;
+            if (rank_arg.getNumOccurrences() > 0) { // only the given rank
+              opts.ranks.push_back(rank_arg);
+            }
+            opts.cache_dir = cache_dir_arg;
+            opts.cache_size_limit = uint64_t(cache_size_arg) << 20;
+            opts.source_digest = cache_source_digest_arg;
+            opts.symbolic_rank = symbolic_rank_arg;
+            MPM.addPass(GenerateMPNetAllPass(opts));
+            if (report) {
+              MPM.addPass(ReportInstrumentationPass());
+            }
+          } else if (PassName.startswith("generate-mpn")) {
             MPM.addPass(RequireAnalysisPass<CallGraphAnalysis, Module>());
-            MPM.addPass(RequireAnalysisPass<ModuleSummaryIndexAnalysis, Module>());
             MPM.addPass(GenerateMPNetPass());
+            if (report) {
+              MPM.addPass(ReportInstrumentationPass());
+            }
           }
           return true;
         }
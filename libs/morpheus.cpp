@@ -0,0 +1,741 @@
+//===----------------------------------------------------------------------===//
+//
+// morpheus
+//
+// Native driver of Morpheus. It compiles the source by clang within the same
+// process and generates MP nets directly from the in-memory module. It follows
+// the interface of `src/morpheus.py`. A program consisting of several
+// translation units is compiled in parallel and linked into a single module.
+//
+// If a cache directory is given, mpi.h and common system headers are parsed
+// only once and reused as a precompiled header by the C++ sources.
+//
+// With `-serve <socket>` it runs as a server answering requests of
+// `src/morpheus_client.py`. The compiled modules and their analyses are kept
+// in memory and reused as long as none of the compiled files changes. Only
+// the least recently used programs are kept (-serve-modules). The analyses
+// are reused only by requests with a single job, the parallel workers
+// compute their own ones on a copy of the module.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/Version.h"
+#include "clang/CodeGen/CodeGenAction.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Frontend/Utils.h"
+
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "morpheus/Support/Instrumentation.hpp"
+#include "morpheus/Support/NetCache.hpp"
+#include "morpheus/Transforms/GenerateMPNetAll.hpp"
+#include "morpheus/Transforms/MorpheusPrepare.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+static cl::list<std::string> sources_arg(
+    cl::Positional, cl::ZeroOrMore,
+    cl::desc("<source files>"));
+
+static cl::opt<unsigned> nproc_arg(
+    "np", cl::init(1),
+    cl::desc("Number of processes."));
+
+static cl::alias nproc_alias(
+    "nproc", cl::aliasopt(nproc_arg),
+    cl::desc("Alias for -np"));
+
+static cl::opt<unsigned> jobs_arg(
+    "j", cl::init(1),
+    cl::desc("Number of translation units compiled and ranks generated in parallel."));
+
+static cl::alias jobs_alias(
+    "jobs", cl::aliasopt(jobs_arg),
+    cl::desc("Alias for -j"));
+
+static cl::opt<std::string> output_dir_arg(
+    "o", cl::init("."),
+    cl::desc("Output directory"));
+
+static cl::alias output_dir_alias(
+    "output-dir", cl::aliasopt(output_dir_arg),
+    cl::desc("Alias for -o"));
+
+static cl::opt<std::string> cache_dir_arg(
+    "cache-dir", cl::init(""),
+    cl::desc("Cache directory of MP nets and precompiled headers (disabled if not set)"));
+
+static cl::opt<unsigned> cache_size_arg(
+    "cache-size", cl::init(512),
+    cl::desc("Size limit of the cache in MiB"));
+
+static cl::opt<bool> symbolic_rank_arg(
+    "symbolic-rank", cl::init(false),
+    cl::desc("Generate a single MP net per class of ranks given by rank predicates"));
+
+static cl::opt<std::string> serve_arg(
+    "serve", cl::init(""),
+    cl::desc("Run as a server listening on the given Unix socket"));
+
+static cl::opt<unsigned> serve_modules_arg(
+    "serve-modules", cl::init(8),
+    cl::desc("Number of compiled programs kept in memory by the server"));
+
+static cl::opt<std::string> time_trace_arg(
+    "morpheus-time-trace", cl::init(""),
+    cl::desc("Store the Chrome trace of phases of MP net generation into the file "
+             "(the summary goes to <file>.summary.json)"));
+
+static cl::opt<bool> memory_stats_arg(
+    "morpheus-memory-stats", cl::init(false),
+    cl::desc("Account the memory of nets and analyses and print a report"));
+
+static cl::list<std::string> includes_arg(
+    "I", cl::Prefix, cl::ZeroOrMore,
+    cl::desc("Add directory to include search path"));
+
+static cl::alias includes_alias(
+    "includes", cl::aliasopt(includes_arg),
+    cl::desc("Alias for -I"));
+
+// a file the module is compiled from, together with its modification time
+using Dependency = std::pair<std::string, std::time_t>;
+
+static const char *MPI_INCLUDE_DIR = "/usr/include/mpi";
+
+// NOTE: the flags correspond to those used within `src/morpheus.py`
+static std::vector<std::string> get_flags(ArrayRef<std::string> includes) {
+  std::vector<std::string> flags = {
+    "-g",
+    "-O0",
+    "-Xclang", "-disable-O0-optnone", // allow to run optimization passes later
+    "-resource-dir", CLANG_RESOURCE_DIR,
+    "-I", MPI_INCLUDE_DIR,
+  };
+
+  for (const std::string &incl : includes) {
+    flags.push_back("-I");
+    flags.push_back(incl);
+  }
+  return flags;
+}
+
+// Runs the clang frontend in the current process. If `deps` are given, they are
+// filled by all the files read by the compilation (the source and the headers).
+static bool run_frontend(ArrayRef<std::string> args, clang::FrontendAction &action,
+                         std::vector<Dependency> *deps=nullptr) {
+  std::vector<const char *> c_args = { "clang++" };
+  for (const std::string &arg : args) {
+    c_args.push_back(arg.c_str());
+  }
+
+  IntrusiveRefCntPtr<clang::DiagnosticOptions> diag_opts = new clang::DiagnosticOptions();
+  IntrusiveRefCntPtr<clang::DiagnosticsEngine> diags = new clang::DiagnosticsEngine(
+    new clang::DiagnosticIDs(), &*diag_opts,
+    new clang::TextDiagnosticPrinter(errs(), &*diag_opts));
+
+  std::shared_ptr<clang::CompilerInvocation> invocation =
+    clang::createInvocationFromCommandLine(c_args, diags);
+  if (!invocation) {
+    return false;
+  }
+  // NOTE: the driver adds -disable-free, that makes clang leak the AST,
+  //       Sema and the preprocessor at the end of the compilation; it is
+  //       fine for a single compilation, but not for a long-running server
+  invocation->getFrontendOpts().DisableFree = false;
+
+  clang::CompilerInstance ci;
+  ci.setInvocation(invocation);
+  ci.createDiagnostics();
+
+  if (!ci.ExecuteAction(action)) {
+    return false;
+  }
+
+  if (deps) {
+    clang::SourceManager &sm = ci.getSourceManager();
+    for (auto it = sm.fileinfo_begin(); it != sm.fileinfo_end(); ++it) {
+      const clang::FileEntry *fe = it->first;
+      deps->emplace_back(fe->getName().str(), fe->getModificationTime());
+    }
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+// Precompiled header
+
+static const char *PCH_PREFIX_HEADER =
+  "#include <mpi.h>\n"
+  "#include <cstdio>\n"
+  "#include <cstdlib>\n";
+
+// NOTE: the PCH is built as a C++ header, hence only C++ sources can use it
+static bool is_cxx_source(StringRef source) {
+  StringRef ext = sys::path::extension(source);
+  return ext == ".cpp" || ext == ".cc" || ext == ".cxx" || ext == ".c++" || ext == ".C";
+}
+
+// Returns the digest of the sizes and modification times of the files and
+// fills their dependencies. An empty string is returned if any of them is
+// missing.
+static std::string get_state_digest(ArrayRef<std::string> files,
+                                    std::vector<Dependency> &file_deps) {
+  std::string state;
+  for (const std::string &file : files) {
+    sys::fs::file_status status;
+    if (sys::fs::status(file, status)) {
+      return "";
+    }
+    std::time_t mtime = sys::toTimeT(status.getLastModificationTime());
+    state += file + ":" + std::to_string(status.getSize()) + ":" + std::to_string(mtime) + "\n";
+    file_deps.emplace_back(file, mtime);
+  }
+  return NetCache::get_digest(state);
+}
+
+// Returns a PCH of mpi.h and common system headers stored in the cache
+// directory; it is built on the first use. The PCH is keyed by the version of
+// clang and the flags, together with the sizes and modification times of all
+// the headers it is built from (listed in its dependency file), so a change of
+// any of them leads to a new PCH. An empty string is returned if the PCH
+// cannot be built.
+static std::string get_pch(StringRef cache_dir, ArrayRef<std::string> flags,
+                           std::vector<Dependency> &deps) {
+  std::string key_data = clang::getClangFullVersion() + "\n" + PCH_PREFIX_HEADER;
+  for (const std::string &flag : flags) {
+    key_data += flag + "\n";
+  }
+  std::string key = NetCache::get_digest(key_data);
+
+  SmallString<128> pch_dir(cache_dir);
+  sys::path::append(pch_dir, "pch");
+  if (sys::fs::create_directories(pch_dir)) {
+    return "";
+  }
+  SmallString<128> header_path(pch_dir), deps_path(pch_dir);
+  sys::path::append(header_path, key + ".h");
+  sys::path::append(deps_path, key + ".deps");
+
+  auto get_pch_path = [&] (StringRef state) {
+    SmallString<128> pch_path(pch_dir);
+    sys::path::append(pch_path, key + "-" + state + ".pch");
+    return pch_path.str().str();
+  };
+
+  // the PCH built from the current state of the headers
+  if (ErrorOr<std::unique_ptr<MemoryBuffer>> deps_file = MemoryBuffer::getFile(deps_path)) {
+    SmallVector<StringRef, 64> lines;
+    (*deps_file)->getBuffer().split(lines, '\n', -1, /* KeepEmpty */ false);
+
+    std::vector<std::string> headers(lines.begin(), lines.end());
+    std::vector<Dependency> pch_deps;
+    std::string state = get_state_digest(headers, pch_deps);
+    if (!state.empty() && sys::fs::exists(get_pch_path(state))) {
+      deps.insert(deps.end(), pch_deps.begin(), pch_deps.end());
+      return get_pch_path(state);
+    }
+  }
+
+  // NOTE: clang checks the modification time of the header when the PCH is
+  //       loaded, hence an existing header is never rewritten. The hard link
+  //       fails if another process has created the header in the meantime.
+  int fd;
+  SmallString<128> tmp_path;
+  if (!sys::fs::exists(header_path)) {
+    if (sys::fs::createUniqueFile(header_path + ".tmp-%%%%%%", fd, tmp_path)) {
+      return "";
+    }
+    {
+      raw_fd_ostream os(fd, /* shouldClose */ true);
+      os << PCH_PREFIX_HEADER;
+    }
+    sys::fs::create_hard_link(tmp_path, header_path);
+    sys::fs::remove(tmp_path);
+  }
+
+  SmallString<128> pch_tmp_path;
+  if (sys::fs::createUniqueFile(header_path + ".pch.tmp-%%%%%%", fd, pch_tmp_path)) {
+    return "";
+  }
+  close(fd);
+
+  std::vector<std::string> args(flags.begin(), flags.end());
+  args.insert(args.end(), {"-x", "c++-header", header_path.str().str(), "-o", pch_tmp_path.str().str()});
+
+  TimeScope ts("pch");
+  clang::GeneratePCHAction action;
+  std::vector<Dependency> built_deps;
+  std::vector<std::string> headers;
+  std::vector<Dependency> pch_deps;
+  std::string state;
+  if (run_frontend(args, action, &built_deps)) {
+    for (const Dependency &dep : built_deps) {
+      headers.push_back(dep.first);
+    }
+    std::sort(headers.begin(), headers.end());
+    headers.erase(std::unique(headers.begin(), headers.end()), headers.end());
+    state = get_state_digest(headers, pch_deps);
+  }
+  if (state.empty() || sys::fs::rename(pch_tmp_path, get_pch_path(state))) {
+    errs() << "morpheus: the precompiled header cannot be built, continuing without it.\n";
+    sys::fs::remove(pch_tmp_path);
+    return "";
+  }
+
+  // NOTE: the list of headers is replaced atomically as the PCH itself
+  std::string deps_data;
+  for (const std::string &header : headers) {
+    deps_data += header + "\n";
+  }
+  if (!sys::fs::createUniqueFile(deps_path + ".tmp-%%%%%%", fd, tmp_path)) {
+    {
+      raw_fd_ostream os(fd, /* shouldClose */ true);
+      os << deps_data;
+    }
+    if (sys::fs::rename(tmp_path, deps_path)) {
+      sys::fs::remove(tmp_path);
+    }
+  }
+
+  deps.insert(deps.end(), pch_deps.begin(), pch_deps.end());
+  return get_pch_path(state);
+}
+
+// -------------------------------------------------------------------------- //
+// Compilation
+
+// NOTE: the module is kept in memory
+static std::unique_ptr<Module> compile(StringRef source, ArrayRef<std::string> flags,
+                                       StringRef pch, LLVMContext &ctx,
+                                       std::vector<Dependency> &deps) {
+  TimeScope ts("compile", source);
+  std::vector<std::string> args(flags.begin(), flags.end());
+  bool use_pch = !pch.empty() && is_cxx_source(source);
+  if (use_pch) {
+    args.push_back("-include-pch");
+    args.push_back(pch.str());
+  }
+  args.push_back(source.str());
+
+  clang::EmitLLVMOnlyAction action(&ctx);
+  if (run_frontend(args, action, &deps)) {
+    return action.takeModule();
+  }
+  if (!use_pch) {
+    return nullptr;
+  }
+
+  // NOTE: e.g. the source defines macros changing the MPI headers
+  errs() << "morpheus: the compilation of '" << source
+         << "' with the precompiled header failed, retrying without it.\n";
+  return compile(source, flags, "", ctx, deps);
+}
+
+// NOTE: each translation unit is compiled within its own context by a worker
+//       of the pool. The modules are passed into the main context via in-memory
+//       bitcode and linked there, the first one gives the name to the MP nets.
+static std::unique_ptr<Module> compile_all(ArrayRef<std::string> sources,
+                                           ArrayRef<std::string> includes,
+                                           unsigned jobs, LLVMContext &ctx,
+                                           std::vector<Dependency> &deps) {
+  std::vector<std::string> flags = get_flags(includes);
+  std::string pch;
+  if (!cache_dir_arg.empty() && llvm::any_of(sources, is_cxx_source)) {
+    pch = get_pch(cache_dir_arg, flags, deps);
+  }
+
+  if (sources.size() == 1) {
+    std::unique_ptr<Module> m = compile(sources[0], flags, pch, ctx, deps);
+    if (!m) {
+      errs() << "Compilation of '" << sources[0] << "' failed.\n";
+    }
+    return m;
+  }
+
+  std::vector<SmallVector<char, 0>> bitcodes(sources.size());
+  std::vector<std::vector<Dependency>> tu_deps(sources.size());
+  std::vector<char> compiled(sources.size(), false);
+
+  ThreadPool pool(std::max(1u, std::min<unsigned>(jobs, sources.size())));
+  for (size_t i = 0; i < sources.size(); i++) {
+    pool.async([&, i] {
+      LLVMContext tu_ctx;
+      std::unique_ptr<Module> tu = compile(sources[i], flags, pch, tu_ctx, tu_deps[i]);
+      if (!tu) {
+        return;
+      }
+      raw_svector_ostream bitcode_os(bitcodes[i]);
+      WriteBitcodeToFile(*tu, bitcode_os);
+      compiled[i] = true;
+    });
+  }
+  pool.wait();
+
+  std::unique_ptr<Module> m;
+  for (size_t i = 0; i < sources.size(); i++) {
+    if (!compiled[i]) {
+      errs() << "Compilation of '" << sources[i] << "' failed.\n";
+      return nullptr;
+    }
+    deps.insert(deps.end(), tu_deps[i].begin(), tu_deps[i].end());
+
+    Expected<std::unique_ptr<Module>> tu = parseBitcodeFile(
+      MemoryBufferRef(StringRef(bitcodes[i].data(), bitcodes[i].size()), sources[i]), ctx);
+    if (!tu) {
+      logAllUnhandledErrors(tu.takeError(), errs(), "morpheus: ");
+      return nullptr;
+    }
+
+    TimeScope ts("link", sources[i]);
+    if (!m) {
+      m = std::move(*tu);
+    } else if (Linker::linkModules(*m, std::move(*tu))) {
+      errs() << "Linking of '" << sources[i] << "' failed.\n";
+      return nullptr;
+    }
+  }
+  return m;
+}
+
+struct AnalysisManagers {
+  PassBuilder pb;
+  LoopAnalysisManager lam;
+  FunctionAnalysisManager fam;
+  CGSCCAnalysisManager cgam;
+  ModuleAnalysisManager mam;
+
+  AnalysisManagers() {
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+  }
+};
+
+static void generate(Module &m, ModuleAnalysisManager &mam, GenerateMPNetAllOptions opts) {
+  opts.cache_dir = cache_dir_arg;
+  opts.cache_size_limit = uint64_t(cache_size_arg) << 20;
+
+  ModulePassManager mpm;
+  add_prepare_passes(mpm);
+  mpm.addPass(RequireAnalysisPass<CallGraphAnalysis, Module>());
+  mpm.addPass(GenerateMPNetAllPass(opts));
+  mpm.run(m, mam);
+}
+
+// -------------------------------------------------------------------------- //
+// Server
+
+namespace {
+
+  // NOTE: the number of processes is bounded as each of the ranks is
+  //       pruned (and kept) in memory
+  constexpr int64_t MAX_NPROC = 1 << 16;
+
+  // NOTE: the members are destroyed in the reverse order, hence the analyses
+  //       go first, then the module and finally its context.
+  struct CachedModule {
+    LLVMContext ctx;
+    std::unique_ptr<Module> m;
+    std::vector<Dependency> deps;
+    AnalysisManagers ams;
+    uint64_t last_used = 0;
+
+    bool is_up_to_date() const {
+      for (const Dependency &dep : deps) {
+        sys::fs::file_status status;
+        if (sys::fs::status(dep.first, status) ||
+            sys::toTimeT(status.getLastModificationTime()) != dep.second) {
+          return false;
+        }
+      }
+      return true;
+    }
+  };
+
+  class Server {
+  public:
+    // Request (one JSON object per line):
+    //   {"sources": [...], "includes": [...], "nproc": N, "rank": R,
+    //    "jobs": J, "output_dir": "...", "symbolic_rank": true|false}
+    // where all but "sources" are optional (all the ranks by default).
+    // The jobs are capped by the number of hardware threads. NOTE: with more
+    // than one job, the workers of GenerateMPNetAllPass parse their own copy
+    // of the module and so the kept analyses are not reused.
+    //
+    // Response:
+    //   {"status": "ok", "cached": true|false, "time_ms": T}
+    //   {"status": "error", "message": "..."}
+    std::string handle(StringRef line) {
+      auto start = std::chrono::steady_clock::now();
+
+      Expected<json::Value> request = json::parse(line);
+      if (!request) {
+        return error(toString(request.takeError()));
+      }
+      const json::Object *obj = request->getAsObject();
+      const json::Array *sources_val = obj ? obj->getArray("sources") : nullptr;
+      if (!sources_val || sources_val->empty()) {
+        return error("the request has to contain a non-empty list of sources");
+      }
+
+      std::vector<std::string> sources, includes;
+      for (const json::Value &v : *sources_val) {
+        if (Optional<StringRef> str = v.getAsString()) {
+          sources.push_back(str->str());
+        }
+      }
+      if (const json::Array *includes_val = obj->getArray("includes")) {
+        for (const json::Value &v : *includes_val) {
+          if (Optional<StringRef> str = v.getAsString()) {
+            includes.push_back(str->str());
+          }
+        }
+      }
+
+      int64_t nproc = obj->getInteger("nproc").getValueOr(1);
+      if (nproc < 1 || nproc > MAX_NPROC) {
+        return error("the number of processes has to be within 1 and " + std::to_string(MAX_NPROC));
+      }
+      int64_t jobs = obj->getInteger("jobs").getValueOr(1);
+      if (jobs < 1) {
+        return error("the number of jobs has to be positive");
+      }
+
+      GenerateMPNetAllOptions opts;
+      opts.nproc = nproc;
+      opts.jobs = std::min<int64_t>(jobs, std::max(1u, std::thread::hardware_concurrency()));
+      opts.output_dir = obj->getString("output_dir").getValueOr(".").str();
+      opts.symbolic_rank = obj->getBoolean("symbolic_rank").getValueOr(false);
+      if (Optional<int64_t> rank = obj->getInteger("rank")) {
+        if (*rank < 0 || *rank >= opts.nproc) {
+          return error("the rank is out of the range of processes");
+        }
+        opts.ranks.push_back(*rank);
+      }
+
+      std::string key;
+      for (const std::string &str : sources) {
+        key += str + "\n";
+      }
+      for (const std::string &str : includes) {
+        key += "-I" + str + "\n";
+      }
+
+      bool cached = true;
+      std::unique_ptr<CachedModule> &entry = modules[key];
+      if (!entry || !entry->is_up_to_date()) {
+        cached = false;
+        entry.reset(); // release the previous module before compiling a new one
+        auto fresh = std::make_unique<CachedModule>();
+        fresh->m = compile_all(sources, includes, opts.jobs, fresh->ctx, fresh->deps);
+        if (!fresh->m) {
+          modules.erase(key);
+          return error("compilation failed");
+        }
+        entry = std::move(fresh);
+      }
+      // NOTE: the entry is the most recently used one, hence it is kept
+      entry->last_used = ++requests;
+      evict();
+
+      generate(*entry->m, entry->ams.mam, opts);
+      // NOTE: the trace of each request replaces the previous one, so the
+      //       events of a long-running server do not accumulate
+      if (!time_trace_arg.empty()) {
+        Instrumentation::get().write(time_trace_arg);
+        Instrumentation::get().clear();
+      }
+      if (memory_stats_arg) {
+        MemoryAccounting::get().print_report(errs());
+      }
+
+      auto time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+      return to_string(json::Object{
+        {"status", "ok"},
+        {"cached", cached},
+        {"time_ms", int64_t(time.count())},
+      });
+    }
+
+  private:
+    // drops the least recently used programs over the limit
+    void evict() {
+      while (modules.size() > std::max(1u, unsigned(serve_modules_arg))) {
+        auto lru = std::min_element(
+          modules.begin(), modules.end(),
+          [] (const auto &e1, const auto &e2) { return e1.second->last_used < e2.second->last_used; });
+        modules.erase(lru);
+      }
+    }
+
+    static std::string error(StringRef message) {
+      return to_string(json::Object{{"status", "error"}, {"message", message}});
+    }
+
+    static std::string to_string(json::Value value) {
+      std::string str;
+      raw_string_ostream os(str);
+      os << value;
+      return os.str();
+    }
+
+    std::map<std::string, std::unique_ptr<CachedModule>> modules;
+    uint64_t requests = 0;
+  };
+} // end anonymous namespace
+
+static bool write_all(int fd, StringRef data) {
+  while (!data.empty()) {
+    ssize_t n = write(fd, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data = data.drop_front(n);
+  }
+  return true;
+}
+
+// NOTE: the requests are processed one by one, each of them may use
+//       the parallel workers of GenerateMPNetAllPass.
+static int serve(StringRef socket_path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    errs() << "The socket path '" << socket_path << "' is too long.\n";
+    return 1;
+  }
+  std::memcpy(addr.sun_path, socket_path.data(), socket_path.size());
+
+  int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    errs() << "Cannot create a socket: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  sys::fs::remove(socket_path);
+  if (bind(server_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(server_fd, SOMAXCONN) < 0) {
+    errs() << "Cannot listen on '" << socket_path << "': " << std::strerror(errno) << "\n";
+    close(server_fd);
+    return 1;
+  }
+  errs() << "morpheus: listening on '" << socket_path << "'\n";
+
+  Server server;
+  while (true) {
+    int fd = accept(server_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      errs() << "Cannot accept a connection: " << std::strerror(errno) << "\n";
+      break;
+    }
+
+    std::string buffer;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+      buffer.append(chunk, n);
+      size_t eol;
+      while ((eol = buffer.find('\n')) != std::string::npos) {
+        std::string response = server.handle(StringRef(buffer).take_front(eol)) + "\n";
+        buffer.erase(0, eol + 1);
+        if (!write_all(fd, response)) {
+          break;
+        }
+      }
+    }
+    close(fd);
+  }
+
+  close(server_fd);
+  sys::fs::remove(socket_path);
+  return 1;
+}
+
+// -------------------------------------------------------------------------- //
+
+int main(int argc, char *argv[]) {
+  InitLLVM init(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "Morpheus - generator of MP nets\n");
+
+  if (!time_trace_arg.empty()) {
+    Instrumentation::get().enable();
+  }
+  if (memory_stats_arg) {
+    MemoryAccounting::get().enable();
+  }
+
+  if (!serve_arg.empty()) {
+    return serve(serve_arg);
+  }
+  if (sources_arg.empty()) {
+    errs() << "At least one source file has to be given.\n";
+    return 1;
+  }
+
+  LLVMContext ctx;
+  std::vector<Dependency> deps;
+  std::unique_ptr<Module> m = compile_all(sources_arg, includes_arg, jobs_arg, ctx, deps);
+  if (!m) {
+    return 1;
+  }
+
+  GenerateMPNetAllOptions opts;
+  opts.nproc = nproc_arg;
+  opts.output_dir = output_dir_arg;
+  opts.jobs = jobs_arg;
+  opts.symbolic_rank = symbolic_rank_arg;
+
+  AnalysisManagers ams;
+  generate(*m, ams.mam, opts);
+
+  if (memory_stats_arg) {
+    MemoryAccounting::get().print_report(errs());
+  }
+  if (!time_trace_arg.empty() && !Instrumentation::get().write(time_trace_arg)) {
+    return 1;
+  }
+  return 0;
+}
@@ -1,34 +1,51 @@
 import os
-import io
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
 
 import click
 from plumbum import local
 
+import netcache
+from pch import compile_with_pch, get_pch, is_cxx_source, MPI_INCLUDE_DIR
+
 @click.command()
-@click.argument("source-file")
+@click.argument("source-files", nargs=-1, required=True)
 @click.option("-np", "--nproc", default=1, help="Number of processes.")
+@click.option("-j", "--jobs", default=1, help="Number of translation units compiled and ranks generated in parallel.")
 @click.option("-o", "--output-dir", default=None, type=str, help="Output directory")
+@click.option("--cache-dir", default=None, type=str, help="Cache directory of MP nets and precompiled headers (disabled if not set)")
+@click.option("--cache-size", default=512, help="Size limit of the cache in MiB.")
+@click.option("--time-trace", default=None, type=str, help="Store Chrome trace of generation phases into the file.")
+@click.option("--memory-stats", is_flag=True, help="Print a report of the memory used by nets and analyses.")
+@click.option("--symbolic-rank", is_flag=True, help="Generate a single MP net per class of ranks given by rank predicates.")
 @click.option("-I", "--includes", default=None, type=str, multiple=True, help="Add directory to include search path")
-def generate_mpn(source_file, nproc, output_dir, includes):
+def generate_mpn(source_files, nproc, jobs, output_dir, cache_dir, cache_size, time_trace, memory_stats, symbolic_rank, includes):
     cwd = os.path.abspath(os.getcwd())
 
     clang_compiler = "clang++"
 
     # prepare all includes
-    incls = ["/usr/include/mpi"] + list([] if includes is None else includes[:])
+    incls = [MPI_INCLUDE_DIR] + list([] if includes is None else includes[:])
 
     flatten = lambda l: [item for sublist in l for item in sublist]
-    ll = local[clang_compiler][
-        "-S",
-        "-emit-llvm",                    # TODO: do I have to emit ll code? binary should be as good as ll
+    include_flags = flatten(("-I", incl) for incl in incls)
+    flags = [
         "-g",
         "-O0",
-        flatten(("-I", incl) for incl in incls),
+        *include_flags,
         "-Xclang","-disable-O0-optnone",     # allow to run optimization passes later
-        "-o", "-",                           # redirect output to stdout
-        source_file
     ]
 
+    # NOTE: mpi.h and common system headers are parsed only once
+    pch = None
+    if cache_dir is not None and any(is_cxx_source(s) for s in source_files):
+        pch = get_pch(os.path.abspath(cache_dir), clang_compiler, flags)
+
+    compile_tu = lambda source_file, output: compile_with_pch(
+        clang_compiler, ["-c", "-emit-llvm", *flags, "-o", output], pch, source_file
+    )
+
     lib_morph = "libMorph.so"
     # assert any(path in )
 
@@ -39,38 +56,66 @@ def generate_mpn(source_file, nproc, output_dir, includes):
     ), "Could not find libMorph.so. Check is LD_LIBRARY_PATH is set properly."
 
     opt_tool = "opt"
+    link_tool = "llvm-link"
 
-    processes = []
-    for p in range(nproc):
-        with local.cwd(cwd):
-            a = local[opt_tool][
-                "-S",
-                "--load", lib_morph,              # use old PM in order to process cli arguments (cl::opt)
-                "--load-pass-plugin", lib_morph,  # use new PM
-                "-passes", "substituterank",      # pass pruneprocess
-                "-rank", str(p),                  # prune rank 'p'
-                "-o", "-"                         # redirect output to stdout
-            ]
-            b = local[opt_tool][
-                "-S",
-                "-mem2reg",
-                "-constprop",
-                "-simplifycfg",
-                "-o", "-"
-            ]
-            c = local[opt_tool][
-                "-disable-output",
-                "--load-pass-plugin", lib_morph,
-                "-passes", "generate-mpn",
-                "-o", "-"
+    if output_dir is None:
+        output_dir = cwd
+
+    # NOTE: the nets are looked up by the preprocessed sources, hence on a hit
+    #       of all the ranks neither the compilation nor opt is run. The symbolic
+    #       nets are not cached, and the trace and the memory report need a run.
+    source_digest = None
+    if cache_dir is not None and not (symbolic_rank or time_trace or memory_stats):
+        source_digest = netcache.get_source_digest(clang_compiler, flags, include_flags, source_files)
+        keys = [netcache.get_key(source_digest, rank, nproc) for rank in range(nproc)]
+        if netcache.restore(os.path.abspath(cache_dir), keys, output_dir):
+            print("MP net cache: {} hits (restored by the driver)".format(nproc), file=sys.stderr)
+            return
+
+    with local.cwd(cwd), tempfile.TemporaryDirectory() as tmp_dir:
+        # NOTE: each translation unit is compiled into its own bitcode file,
+        #       the compilations are independent and so they run in parallel.
+        bitcodes = [
+            os.path.join(tmp_dir, "{}-{}.bc".format(i, os.path.basename(source_file)))
+            for i, source_file in enumerate(source_files)
+        ]
+        with ThreadPoolExecutor(max_workers=max(1, jobs)) as executor:
+            list(executor.map(lambda args: compile_tu(*args), zip(source_files, bitcodes)))
+
+        # NOTE: the IR is parsed only once, all the ranks are generated
+        #       within a single run of opt.
+        mpn = local[opt_tool][
+            "-disable-output",
+            "--load", lib_morph,              # use old PM in order to process cli arguments (cl::opt)
+            "--load-pass-plugin", lib_morph,  # use new PM
+            "-passes", "generate-mpn-all",    # generate MP nets for all ranks
+            "-nproc", str(nproc),             # number of processes
+            "-mpn-jobs", str(jobs),           # number of parallel workers
+            "-mpn-output-dir", output_dir,    # each net is stored into its own file
+        ]
+        if cache_dir is not None:
+            mpn = mpn[
+                "-mpn-cache-dir", os.path.abspath(cache_dir),
+                "-mpn-cache-size", str(cache_size)
             ]
+        if source_digest is not None:
+            mpn = mpn["-mpn-cache-source-digest", source_digest]
+
+        if time_trace is not None:
+            mpn = mpn["-morpheus-time-trace", os.path.abspath(time_trace)]
+        if memory_stats:
+            mpn = mpn["-morpheus-memory-stats"]
+        if symbolic_rank:
+            mpn = mpn["-mpn-symbolic-rank"]
 
-            cmd = ll | a | b | c
-            output = cmd();
-            buf = io.StringIO(output)
-            fname = buf.readline()
-            with open(os.path.join(output_dir, fname.rstrip()), "w") as file:
-                file.write(buf.read());
+        if len(bitcodes) == 1:
+            cmd = mpn[bitcodes[0]]
+        else:
+            # NOTE: the whole program is analysed at once, the MP nets
+            #       are named after the first translation unit.
+            ll = local[link_tool]["-o", "-", bitcodes]
+            cmd = ll | mpn["-mpn-source-name", source_files[0]]
+        cmd()
 
 if __name__ == "__main__":
     generate_mpn()
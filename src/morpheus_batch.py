@@ -0,0 +1,268 @@
+import collections
+import json
+import os
+import shlex
+import sys
+import tempfile
+import threading
+import time
+
+import click
+from plumbum import local, ProcessExecutionError
+
+from pch import compile_with_pch, get_pch, is_cxx_source, MPI_INCLUDE_DIR
+
+SOURCE_EXTENSIONS = (".c", ".cc", ".cpp", ".cxx")
+
+Source = collections.namedtuple("Source", ["path", "flags"])
+Result = collections.namedtuple("Result", ["name", "duration", "error"])
+
+
+# -------------------------------------------------------------------------- #
+# sources
+
+def sources_from_compile_commands(path):
+    """ Reads sources and their relevant flags (-I, -D, -std) from compilation database. """
+    with open(path) as f:
+        entries = json.load(f)
+
+    sources = []
+    for entry in entries:
+        directory = entry.get("directory", os.path.dirname(path))
+        args = entry["arguments"] if "arguments" in entry else shlex.split(entry["command"])
+
+        flags = []
+        it = iter(args[1:])
+        for arg in it:
+            if arg in ("-I", "-D"):
+                arg += next(it, "")
+            if arg.startswith("-I"):
+                flags.append("-I" + os.path.join(directory, arg[2:]))
+            elif arg.startswith("-D") or arg.startswith("-std="):
+                flags.append(arg)
+
+        source = os.path.join(directory, entry["file"])
+        if source.endswith(SOURCE_EXTENSIONS):
+            sources.append(Source(os.path.normpath(source), flags))
+    return sources
+
+def sources_from_directory(path):
+    sources = []
+    for root, _, files in os.walk(path):
+        for f in sorted(files):
+            if f.endswith(SOURCE_EXTENSIONS):
+                sources.append(Source(os.path.join(root, f), []))
+    return sorted(sources)
+
+
+# -------------------------------------------------------------------------- #
+# work-stealing pool
+
+class WorkStealingPool:
+    """ Each worker takes tasks from the back of its own deque and steals
+        from the front of the others when its deque is empty. Tasks spawned
+        by a task are pushed into the deque of the running worker. """
+
+    def __init__(self, num_workers):
+        self.deques = [collections.deque() for _ in range(num_workers)]
+        self.cond = threading.Condition()
+        self.pending = 0
+        self.local = threading.local()
+        self.errors = [] # the exceptions escaped from tasks, the worker goes on
+
+    def submit(self, task):
+        with self.cond:
+            worker = getattr(self.local, "worker", None)
+            if worker is None: # submitted from outside, distribute evenly
+                worker = min(range(len(self.deques)), key=lambda w: len(self.deques[w]))
+            self.deques[worker].append(task)
+            self.pending += 1
+            self.cond.notify_all()
+
+    def _take(self, worker):
+        if self.deques[worker]:
+            return self.deques[worker].pop()
+        for victim in sorted(range(len(self.deques)), key=lambda w: -len(self.deques[w])):
+            if self.deques[victim]:
+                return self.deques[victim].popleft()
+        return None
+
+    def _work(self, worker):
+        self.local.worker = worker
+        while True:
+            with self.cond:
+                task = self._take(worker)
+                while task is None:
+                    if self.pending == 0:
+                        return
+                    self.cond.wait()
+                    task = self._take(worker)
+            try:
+                task()
+            except Exception as e:
+                with self.cond:
+                    self.errors.append(e)
+            finally:
+                with self.cond:
+                    self.pending -= 1
+                    self.cond.notify_all()
+
+    def run(self):
+        threads = [threading.Thread(target=self._work, args=(w,)) for w in range(len(self.deques))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+
+# -------------------------------------------------------------------------- #
+# batch
+
+@click.command()
+@click.argument("input-path")
+@click.option("-np", "--nproc", default=[1], multiple=True, help="Number of processes (can be repeated).")
+@click.option("-j", "--jobs", default=os.cpu_count(), help="Number of parallel jobs.")
+@click.option("-o", "--output-dir", default=None, type=str, help="Output directory")
+@click.option("--cache-dir", default=None, type=str, help="Cache directory of MP nets and precompiled headers (disabled if not set)")
+@click.option("--cache-size", default=512, help="Size limit of the cache in MiB.")
+@click.option("-I", "--includes", default=None, type=str, multiple=True, help="Add directory to include search path")
+def generate_mpn_batch(input_path, nproc, jobs, output_dir, cache_dir, cache_size, includes):
+    """ Generates MP nets for all the sources listed in compile_commands.json
+        or found in the given directory. Each (source, np) is a job. """
+    cwd = os.path.abspath(os.getcwd())
+
+    if os.path.isdir(input_path):
+        sources = sources_from_directory(input_path)
+        root = input_path
+    else:
+        sources = sources_from_compile_commands(input_path)
+        root = os.path.commonpath([os.path.dirname(s.path) for s in sources]) if sources else cwd
+
+    lib_morph = "libMorph.so"
+    assert ("LD_LIBRARY_PATH" in os.environ), "LD_LIBRARY_PATH is not set."
+    assert any(
+        os.path.isfile(os.path.join(path, lib_morph))
+        for path in os.environ["LD_LIBRARY_PATH"].split(os.pathsep)
+    ), "Could not find libMorph.so. Check is LD_LIBRARY_PATH is set properly."
+
+    if output_dir is None:
+        output_dir = cwd
+
+    # NOTE: the sources of the same basename (e.g. in different directories)
+    #       get distinct directories named by their paths relative to root.
+    def get_net_name(source):
+        name, ext = os.path.splitext(os.path.relpath(source.path, root))
+        return name.replace(os.sep, "__") + ext.replace(".", "_")
+
+    # NOTE: few jobs (e.g. a single source) use the idle workers to generate
+    #       the ranks in parallel, many jobs run single-threaded.
+    num_jobs = max(1, len(sources) * len(nproc))
+    mpn_jobs = max(1, jobs // num_jobs)
+
+    incls = [MPI_INCLUDE_DIR] + list([] if includes is None else includes[:])
+
+    # NOTE: the PCH depends on the flags, hence the sources sharing the same
+    #       flags share the PCH as well. It is built once per flags.
+    pchs = {}
+    pchs_lock = threading.Lock()
+
+    def get_flags(source):
+        return [
+            "-g", "-O0",
+            *[arg for incl in incls for arg in ("-I", incl)],
+            *source.flags,
+            "-Xclang", "-disable-O0-optnone", # allow to run optimization passes later
+        ]
+
+    def get_source_pch(source, flags):
+        if cache_dir is None or not is_cxx_source(source.path):
+            return None
+        with pchs_lock:
+            key = tuple(flags)
+            if key not in pchs:
+                pchs[key] = get_pch(os.path.abspath(cache_dir), "clang++", flags)
+            return pchs[key]
+
+    results = []
+    results_lock = threading.Lock()
+
+    # NOTE: any failure of the job is recorded, so it is listed in the summary
+    def timed(name, fn):
+        start = time.monotonic()
+        error = None
+        try:
+            fn()
+        except ProcessExecutionError as e:
+            lines = e.stderr.strip().splitlines()
+            error = lines[-1] if lines else "exit code {}".format(e.retcode)
+        except Exception as e:
+            error = "{}: {}".format(type(e).__name__, e)
+        with results_lock:
+            results.append(Result(name, time.monotonic() - start, error))
+        return error is None
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        pool = WorkStealingPool(max(1, jobs))
+
+        def generate_nets(source, bitcode, np):
+            net_dir = os.path.join(output_dir, get_net_name(source), "np{}".format(np))
+            mpn = local["opt"][
+                "-disable-output",
+                "--load", lib_morph,              # use old PM in order to process cli arguments (cl::opt)
+                "--load-pass-plugin", lib_morph,  # use new PM
+                "-passes", "generate-mpn-all",
+                "-nproc", str(np),
+                "-mpn-jobs", str(min(np, mpn_jobs)),
+                "-mpn-output-dir", net_dir,
+                bitcode
+            ]
+            if cache_dir is not None:
+                mpn = mpn["-mpn-cache-dir", os.path.abspath(cache_dir), "-mpn-cache-size", str(cache_size)]
+
+            def run():
+                os.makedirs(net_dir, exist_ok=True)
+                mpn()
+            timed("{} np={}".format(source.path, np), run)
+
+        def compile_source(i, source):
+            bitcode = os.path.join(tmp_dir, "{}.bc".format(i))
+
+            def compile_tu():
+                flags = get_flags(source)
+                pch = get_source_pch(source, flags)
+                compile_with_pch("clang++", ["-c", "-emit-llvm", *flags, "-o", bitcode], pch, source.path)
+            if not timed("{} (compile)".format(source.path), compile_tu):
+                return
+
+            # NOTE: all the ranks of an np are generated by a single job,
+            #       so the module is loaded and analysed once and the ranks
+            #       of the same class share a single net (see generate-mpn-all).
+            for np in nproc:
+                pool.submit(lambda np=np: generate_nets(source, bitcode, np))
+
+        for i, source in enumerate(sources):
+            pool.submit(lambda i=i, source=source: compile_source(i, source))
+
+        start = time.monotonic()
+        pool.run()
+        wall_time = time.monotonic() - start
+
+    # summary
+    failures = [r for r in results if r.error is not None]
+    print("sources: {}, jobs: {}, failed: {}".format(len(sources), len(results), len(failures)))
+    print("wall time: {:.2f}s, total job time: {:.2f}s".format(wall_time, sum(r.duration for r in results)))
+
+    print("slowest jobs:")
+    for r in sorted(results, key=lambda r: -r.duration)[:5]:
+        print("  {:8.2f}s  {}".format(r.duration, r.name))
+
+    if failures or pool.errors:
+        print("failures:")
+        for r in failures:
+            print("  {}: {}".format(r.name, r.error))
+        for e in pool.errors:
+            print("  (task) {}: {}".format(type(e).__name__, e))
+        sys.exit(1)
+
+if __name__ == "__main__":
+    generate_mpn_batch()
@@ -0,0 +1,52 @@
+import json
+import os
+import socket
+import sys
+
+import click
+
+DEFAULT_SOCKET = os.path.join(os.environ.get("XDG_RUNTIME_DIR", "/tmp"), "morpheus.sock")
+
+@click.command()
+@click.argument("source-files", nargs=-1, required=True)
+@click.option("-np", "--nproc", default=1, help="Number of processes.")
+@click.option("-r", "--rank", default=None, type=int, help="Generate only the given rank.")
+@click.option("-j", "--jobs", default=1, help="Number of translation units compiled and ranks generated in parallel.")
+@click.option("-o", "--output-dir", default=None, type=str, help="Output directory")
+@click.option("-I", "--includes", default=None, type=str, multiple=True, help="Add directory to include search path")
+@click.option("--symbolic-rank", is_flag=True, help="Generate a single MP net per class of ranks given by rank predicates.")
+@click.option("--socket", "socket_path", default=DEFAULT_SOCKET, help="Socket of the server (morpheus -serve <socket>).")
+def generate_mpn(source_files, nproc, rank, jobs, output_dir, includes, symbolic_rank, socket_path):
+    """ Asks a running Morpheus server to (re)generate MP nets. The server keeps
+        the compiled modules and their analyses, hence repeated requests on
+        unchanged files are answered without recompilation. """
+    cwd = os.path.abspath(os.getcwd())
+
+    # NOTE: the server runs in its own working directory
+    request = {
+        "sources": [os.path.abspath(f) for f in source_files],
+        "includes": [os.path.abspath(i) for i in (includes or [])],
+        "nproc": nproc,
+        "jobs": jobs,
+        "output_dir": os.path.abspath(output_dir or cwd),
+        "symbolic_rank": symbolic_rank,
+    }
+    if rank is not None:
+        request["rank"] = rank
+
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            sock.connect(socket_path)
+            sock.sendall((json.dumps(request) + "\n").encode())
+            response = sock.makefile().readline()
+    except OSError as e:
+        sys.exit("Cannot connect to '{}' ({}). Is the server running (morpheus -serve {})?"
+                 .format(socket_path, e.strerror, socket_path))
+
+    response = json.loads(response)
+    if response["status"] != "ok":
+        sys.exit("Morpheus server: {}".format(response["message"]))
+    print("done in {} ms{}".format(response["time_ms"], " (cached module)" if response["cached"] else ""))
+
+if __name__ == "__main__":
+    generate_mpn()
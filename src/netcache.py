@@ -0,0 +1,59 @@
+import hashlib
+import os
+import shutil
+
+from plumbum import local
+
+# NOTE: both have to match the ones of libMorph (MORPHEUS_VERSION in
+#       CMakeLists.txt and NetCache::NET_REVISION), the keys computed here
+#       have to be the same as the ones the nets are stored under.
+MORPHEUS_VERSION = "0.1"
+NET_REVISION = 2
+
+def get_source_digest(compiler, flags, include_flags, source_files):
+    """ Returns the digest of the preprocessed sources together with the
+        compiler and the flags. It is passed to opt (-mpn-cache-source-digest)
+        and used instead of the digest of the module, hence the nets can be
+        looked up before anything is compiled. The names of the sources are
+        included as they name the nets. """
+    digest = hashlib.md5()
+    digest.update(local[compiler]("--version").encode())
+    digest.update("\0".join(flags).encode())
+    for source_file in source_files:
+        digest.update("\0{}\0".format(source_file).encode())
+        digest.update(local[compiler]["-E", include_flags, source_file]().encode())
+    return digest.hexdigest()
+
+def get_key(digest, rank, nproc):
+    """ The same as NetCache::get_key. """
+    key = "{}:{}:{}:{}:{}".format(digest, rank, nproc, MORPHEUS_VERSION, NET_REVISION)
+    return hashlib.md5(key.encode()).hexdigest()
+
+def restore(cache_dir, keys, output_dir):
+    """ Copies the nets of all the keys into the output directory, the same as
+        NetCache::restore. It returns True only if all of them are found,
+        otherwise nothing is copied. """
+    entries = []
+    for key in keys:
+        try:
+            with open(os.path.join(cache_dir, "index", key)) as f:
+                object_path, file_name = f.read().splitlines()[:2]
+        except (OSError, ValueError):
+            return False
+        if not os.path.isfile(object_path):
+            return False
+        entries.append((object_path, file_name))
+
+    # NOTE: ranks of a class share the same net, hence it is copied only once
+    os.makedirs(output_dir, exist_ok=True)
+    restored = set()
+    for object_path, file_name in entries:
+        if file_name in restored:
+            continue
+        restored.add(file_name)
+        try:
+            shutil.copyfile(object_path, os.path.join(output_dir, file_name))
+            os.utime(object_path)  # the least recently used objects are evicted first
+        except OSError:
+            return False
+    return True
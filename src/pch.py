@@ -0,0 +1,116 @@
+import hashlib
+import os
+import re
+import sys
+import tempfile
+
+from plumbum import local
+
+MPI_INCLUDE_DIR = "/usr/include/mpi"
+
+PCH_PREFIX_HEADER = (
+    "#include <mpi.h>\n"
+    "#include <cstdio>\n"
+    "#include <cstdlib>\n"
+)
+
+# NOTE: the PCH is built as a C++ header, hence only C++ sources can use it
+CXX_EXTENSIONS = (".cc", ".cpp", ".cxx", ".c++", ".C")
+
+def is_cxx_source(path):
+    return path.endswith(CXX_EXTENSIONS)
+
+def get_state_digest(files):
+    """ Returns the digest of sizes and modification times of the files,
+        or None if any of them is missing. """
+    state = hashlib.md5()
+    for path in files:
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+        state.update("{}:{}:{}\n".format(path, st.st_size, int(st.st_mtime)).encode())
+    return state.hexdigest()
+
+def parse_dependency_file(path):
+    """ Returns the prerequisites listed in the Makefile-style dependency file. """
+    with open(path) as f:
+        content = f.read().replace("\\\n", " ")
+    _, _, prerequisites = content.partition(": ")
+    return sorted({
+        p.replace("\\ ", " ") for p in re.split(r"(?<!\\)\s+", prerequisites) if p
+    })
+
+def get_pch(cache_dir, compiler, flags):
+    """ Returns a PCH of mpi.h and common system headers stored in the cache
+        directory; it is built on the first use. The PCH is keyed by the version
+        of the compiler and the flags, together with the sizes and modification
+        times of all the headers it is built from (listed in its dependency
+        file), so a change of any of them leads to a new PCH. None is returned
+        if the PCH cannot be built. """
+    key = hashlib.md5()
+    key.update(local[compiler]("--version").encode())
+    key.update(PCH_PREFIX_HEADER.encode())
+    key.update("\n".join(flags).encode())
+    key = key.hexdigest()
+
+    pch_dir = os.path.join(cache_dir, "pch")
+    os.makedirs(pch_dir, exist_ok=True)
+    header = os.path.join(pch_dir, key + ".h")
+    deps = os.path.join(pch_dir, key + ".deps")
+    get_pch_path = lambda state: os.path.join(pch_dir, "{}-{}.pch".format(key, state))
+
+    # the PCH built from the current state of the headers
+    if os.path.isfile(deps):
+        with open(deps) as f:
+            state = get_state_digest(f.read().splitlines())
+        if state is not None and os.path.isfile(get_pch_path(state)):
+            return get_pch_path(state)
+
+    # NOTE: clang checks the modification time of the header when the PCH is
+    #       loaded, hence an existing header is never rewritten. The hard link
+    #       fails if another process has created the header in the meantime.
+    if not os.path.isfile(header):
+        fd, tmp = tempfile.mkstemp(dir=pch_dir, suffix=".h.tmp")
+        with os.fdopen(fd, "w") as f:
+            f.write(PCH_PREFIX_HEADER)
+        try:
+            os.link(tmp, header)
+        except FileExistsError:
+            pass
+        os.remove(tmp)
+
+    fd, tmp = tempfile.mkstemp(dir=pch_dir, suffix=".pch.tmp")
+    os.close(fd)
+    tmp_deps = tmp + ".d"
+    retcode, _, stderr = local[compiler][
+        flags, "-x", "c++-header", header, "-o", tmp, "-MD", "-MF", tmp_deps
+    ].run(retcode=None)
+
+    headers = parse_dependency_file(tmp_deps) if retcode == 0 else []
+    state = get_state_digest(headers) if retcode == 0 else None
+    if os.path.isfile(tmp_deps):
+        os.remove(tmp_deps)
+    if state is None:
+        print("The precompiled header cannot be built, continuing without it.\n" + stderr, file=sys.stderr)
+        os.remove(tmp)
+        return None
+    os.replace(tmp, get_pch_path(state))
+
+    # NOTE: the list of headers is replaced atomically as the PCH itself
+    fd, tmp = tempfile.mkstemp(dir=pch_dir, suffix=".deps.tmp")
+    with os.fdopen(fd, "w") as f:
+        f.write("".join(h + "\n" for h in headers))
+    os.replace(tmp, deps)
+    return get_pch_path(state)
+
+def compile_with_pch(compiler, args, pch, source):
+    """ Compiles the source using the PCH if it is a C++ source. If the
+        compilation with the PCH fails, it is retried without it. """
+    if pch is not None and is_cxx_source(source):
+        retcode, _, stderr = local[compiler][args, "-include-pch", pch, source].run(retcode=None)
+        if retcode == 0:
+            return
+        print("The compilation of {} with the precompiled header failed, retrying without it.\n{}".format(source, stderr),
+              file=sys.stderr)
+    local[compiler][args, source]()
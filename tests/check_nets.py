@@ -0,0 +1,129 @@
+import difflib
+import os
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+
+import click
+
+# NOTE: a case is an IR module with the arguments of opt on its `; ARGS:` lines
+#       (one run per line), its expected nets are stored in the directory
+#       of the same name, e.g. nets/ring.ll -> nets/ring/
+ARGS_PREFIX = "; ARGS:"
+
+
+# -------------------------------------------------------------------------- #
+# runs
+
+def get_runs(case):
+    with open(case) as f:
+        return [shlex.split(line[len(ARGS_PREFIX):]) for line in f if line.startswith(ARGS_PREFIX)]
+
+def generate(opt, plugin, case, args, output_dir):
+    """ Runs opt on the case and stores the nets into the output directory.
+        generate-mpn-all stores the nets by itself, generate-mpn prints the
+        name of the net followed by the net. """
+    run_dir = tempfile.mkdtemp(dir=output_dir)
+    proc = subprocess.run([
+        opt, "-disable-output",
+        "--load", plugin,              # use old PM in order to process cli arguments (cl::opt)
+        "--load-pass-plugin", plugin,  # use new PM
+        *args,
+        "-mpn-output-dir", run_dir,
+        case,
+    ], stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+
+    if proc.returncode != 0:
+        lines = proc.stderr.strip().splitlines()
+        raise RuntimeError(lines[-1] if lines else "exit code {}".format(proc.returncode))
+
+    if proc.stdout:
+        name, _, net = proc.stdout.partition("\n")
+        with open(os.path.join(run_dir, os.path.basename(name)), "w") as f:
+            f.write(net)
+
+    nets = {}
+    for name in os.listdir(run_dir):
+        with open(os.path.join(run_dir, name)) as f:
+            nets[name] = f.read()
+    return nets
+
+def read_expected(expected_dir):
+    nets = {}
+    if os.path.isdir(expected_dir):
+        for name in os.listdir(expected_dir):
+            with open(os.path.join(expected_dir, name)) as f:
+                nets[name] = f.read()
+    return nets
+
+
+# -------------------------------------------------------------------------- #
+# runner
+
+@click.command()
+@click.argument("cases", nargs=-1, required=True)
+@click.option("--opt", required=True, type=str, help="Path to opt.")
+@click.option("--plugin", required=True, type=str, help="Path to libMorph.so.")
+@click.option("--update", is_flag=True, help="Store the generated nets as the expected ones.")
+def check_nets(cases, opt, plugin, update):
+    """ Generates the MP nets of each case and compares them with the expected
+        ones. Fails if any net differs, is missing or is not expected. """
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for case in cases:
+            name = os.path.splitext(os.path.basename(case))[0]
+            expected_dir = os.path.splitext(case)[0]
+
+            generated = {}
+            try:
+                for args in get_runs(case):
+                    for net_name, net in generate(opt, plugin, case, args, tmp_dir).items():
+                        if net_name in generated:
+                            raise RuntimeError("{} is generated by more runs".format(net_name))
+                        generated[net_name] = net
+            except RuntimeError as e:
+                failures.append("{}: failed: {}".format(name, e))
+                print("{:<32} FAILED".format(name))
+                continue
+            if not generated:
+                failures.append("{}: no nets (missing {} line?)".format(name, ARGS_PREFIX))
+                print("{:<32} FAILED".format(name))
+                continue
+
+            if update:
+                shutil.rmtree(expected_dir, ignore_errors=True)
+                os.makedirs(expected_dir)
+                for net_name, net in generated.items():
+                    with open(os.path.join(expected_dir, net_name), "w") as f:
+                        f.write(net)
+                print("{:<32} {} nets updated".format(name, len(generated)))
+                continue
+
+            expected = read_expected(expected_dir)
+            mismatches = 0
+            for net_name in sorted(set(expected) | set(generated)):
+                if net_name not in generated:
+                    failures.append("{}: {} is not generated".format(name, net_name))
+                elif net_name not in expected:
+                    failures.append("{}: {} is not expected".format(name, net_name))
+                elif generated[net_name] != expected[net_name]:
+                    diff = difflib.unified_diff(
+                        expected[net_name].splitlines(), generated[net_name].splitlines(),
+                        "expected/" + net_name, "generated/" + net_name, lineterm="", n=1)
+                    failures.append("{}: {} differs:\n{}".format(name, net_name, "\n".join(diff)))
+                else:
+                    continue
+                mismatches += 1
+            print("{:<32} {}".format(name, "FAILED" if mismatches else "ok"))
+
+    if failures:
+        print("failures:")
+        for failure in failures:
+            print("  {}".format(failure))
+        sys.exit(1)
+
+if __name__ == "__main__":
+    check_nets()
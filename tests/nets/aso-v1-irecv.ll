@@ -0,0 +1,90 @@
+; compiled from examples/all-send-one/aso-v1-irecv.cpp (clang -O0, MPICH)
+; ARGS: -passes generate-mpn-all -nproc 3
+
+source_filename = "aso-v1-irecv.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %size = alloca i32, align 4
+  %saved_stack = alloca i8*, align 8
+  %__vla_expr0 = alloca i64, align 8
+  %i = alloca i32, align 4
+  %src = alloca i32, align 4
+  %rqst = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %argc.addr, i8*** %argv.addr)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  %call2 = call i32 @MPI_Comm_size(i32 1140850688, i32* %size)
+  %0 = load i32, i32* %rank, align 4
+  %cmp = icmp eq i32 %0, 0
+  br i1 %cmp, label %if.then, label %if.else
+
+if.then:
+  %1 = load i32, i32* %size, align 4
+  %sub = sub nsw i32 %1, 1
+  %2 = zext i32 %sub to i64
+  %3 = call i8* @llvm.stacksave()
+  store i8* %3, i8** %saved_stack, align 8
+  %vla = alloca i32, i64 %2, align 16
+  store i64 %2, i64* %__vla_expr0, align 8
+  store i32 0, i32* %i, align 4
+  store i32 1, i32* %src, align 4
+  br label %for.cond
+
+for.cond:
+  %4 = load i32, i32* %src, align 4
+  %5 = load i32, i32* %size, align 4
+  %cmp3 = icmp slt i32 %4, %5
+  br i1 %cmp3, label %for.body, label %for.end
+
+for.body:
+  %6 = load i32, i32* %i, align 4
+  %idxprom = sext i32 %6 to i64
+  %arrayidx = getelementptr inbounds i32, i32* %vla, i64 %idxprom
+  %7 = bitcast i32* %arrayidx to i8*
+  %8 = load i32, i32* %src, align 4
+  %call4 = call i32 @MPI_Irecv(i8* %7, i32 1, i32 1275069445, i32 %8, i32 0, i32 1140850688, i32* %rqst)
+  %call5 = call i32 @MPI_Wait(i32* %rqst, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  br label %for.inc
+
+for.inc:
+  %9 = load i32, i32* %i, align 4
+  %inc = add nsw i32 %9, 1
+  store i32 %inc, i32* %i, align 4
+  %10 = load i32, i32* %src, align 4
+  %inc5 = add nsw i32 %10, 1
+  store i32 %inc5, i32* %src, align 4
+  br label %for.cond
+
+for.end:
+  %11 = load i8*, i8** %saved_stack, align 8
+  call void @llvm.stackrestore(i8* %11)
+  br label %if.end
+
+if.else:
+  %12 = bitcast i32* %rank to i8*
+  %call6 = call i32 @MPI_Send(i8* %12, i32 1, i32 1275069445, i32 0, i32 0, i32 1140850688)
+  br label %if.end
+
+if.end:
+  %call7 = call i32 @MPI_Finalize()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Comm_size(i32, i32*)
+declare i8* @llvm.stacksave()
+declare dso_local i32 @MPI_Irecv(i8*, i32, i32, i32, i32, i32, i32*)
+declare dso_local i32 @MPI_Wait(i32*, %struct.MPI_Status*)
+declare void @llvm.stackrestore(i8*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Finalize()
@@ -0,0 +1,100 @@
+; compiled from examples/all-send-one/aso-v3.cpp (clang -O0, MPICH)
+; ARGS: -passes generate-mpn-all -nproc 3
+
+source_filename = "aso-v3.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %size = alloca i32, align 4
+  %saved_stack = alloca i8*, align 8
+  %__vla_expr0 = alloca i64, align 8
+  %__vla_expr1 = alloca i64, align 8
+  %i = alloca i32, align 4
+  %src = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %argc.addr, i8*** %argv.addr)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  %call2 = call i32 @MPI_Comm_size(i32 1140850688, i32* %size)
+  %0 = load i32, i32* %rank, align 4
+  %cmp = icmp eq i32 %0, 0
+  br i1 %cmp, label %if.then, label %if.else
+
+if.then:
+  %1 = load i32, i32* %size, align 4
+  %sub = sub nsw i32 %1, 1
+  %2 = zext i32 %sub to i64
+  %3 = call i8* @llvm.stacksave()
+  store i8* %3, i8** %saved_stack, align 8
+  %vla = alloca i32, i64 %2, align 16
+  store i64 %2, i64* %__vla_expr0, align 8
+  %4 = load i32, i32* %size, align 4
+  %sub3 = sub nsw i32 %4, 1
+  %5 = zext i32 %sub3 to i64
+  %vla4 = alloca i32, i64 %5, align 16
+  store i64 %5, i64* %__vla_expr1, align 8
+  store i32 0, i32* %i, align 4
+  store i32 1, i32* %src, align 4
+  br label %for.cond
+
+for.cond:
+  %6 = load i32, i32* %src, align 4
+  %7 = load i32, i32* %size, align 4
+  %cmp5 = icmp slt i32 %6, %7
+  br i1 %cmp5, label %for.body, label %for.end
+
+for.body:
+  %8 = load i32, i32* %i, align 4
+  %idxprom = sext i32 %8 to i64
+  %arrayidx = getelementptr inbounds i32, i32* %vla, i64 %idxprom
+  %9 = bitcast i32* %arrayidx to i8*
+  %10 = load i32, i32* %src, align 4
+  %11 = load i32, i32* %i, align 4
+  %idxprom6 = sext i32 %11 to i64
+  %arrayidx7 = getelementptr inbounds i32, i32* %vla4, i64 %idxprom6
+  %call8 = call i32 @MPI_Irecv(i8* %9, i32 1, i32 1275069445, i32 %10, i32 0, i32 1140850688, i32* %arrayidx7)
+  br label %for.inc
+
+for.inc:
+  %12 = load i32, i32* %i, align 4
+  %inc = add nsw i32 %12, 1
+  store i32 %inc, i32* %i, align 4
+  %13 = load i32, i32* %src, align 4
+  %inc9 = add nsw i32 %13, 1
+  store i32 %inc9, i32* %src, align 4
+  br label %for.cond
+
+for.end:
+  %14 = load i32, i32* %size, align 4
+  %sub10 = sub nsw i32 %14, 1
+  %call11 = call i32 @MPI_Waitall(i32 %sub10, i32* %vla4, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  %15 = load i8*, i8** %saved_stack, align 8
+  call void @llvm.stackrestore(i8* %15)
+  br label %if.end
+
+if.else:
+  %16 = bitcast i32* %rank to i8*
+  %call12 = call i32 @MPI_Send(i8* %16, i32 1, i32 1275069445, i32 0, i32 0, i32 1140850688)
+  br label %if.end
+
+if.end:
+  %call13 = call i32 @MPI_Finalize()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Comm_size(i32, i32*)
+declare i8* @llvm.stacksave()
+declare dso_local i32 @MPI_Irecv(i8*, i32, i32, i32, i32, i32, i32*)
+declare dso_local i32 @MPI_Waitall(i32, i32*, %struct.MPI_Status*)
+declare void @llvm.stackrestore(i8*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Finalize()
@@ -0,0 +1,96 @@
+; a compute loop without any MPI call is collapsed, the loop with the
+; communication keeps its constant trip count
+;
+;   for (int i = 0; i < 1000; i++) acc += i * i;
+;   for (int j = 0; j < 3; j++) {
+;     if (rank == 0) MPI_Send(&acc, 1, MPI_INT, 1, 0, MPI_COMM_WORLD);
+;     else           MPI_Recv(&acc, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+;   }
+;
+; ARGS: -passes generate-mpn-all -nproc 2
+
+source_filename = "compute-loop.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %acc = alloca i32, align 4
+  %i = alloca i32, align 4
+  %j = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %argc.addr, i8*** %argv.addr)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  store i32 0, i32* %acc, align 4
+  store i32 0, i32* %i, align 4
+  br label %for.cond
+
+for.cond:
+  %0 = load i32, i32* %i, align 4
+  %cmp = icmp slt i32 %0, 1000
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %1 = load i32, i32* %i, align 4
+  %2 = load i32, i32* %i, align 4
+  %mul = mul nsw i32 %1, %2
+  %3 = load i32, i32* %acc, align 4
+  %add = add nsw i32 %3, %mul
+  store i32 %add, i32* %acc, align 4
+  br label %for.inc
+
+for.inc:
+  %4 = load i32, i32* %i, align 4
+  %inc = add nsw i32 %4, 1
+  store i32 %inc, i32* %i, align 4
+  br label %for.cond
+
+for.end:
+  store i32 0, i32* %j, align 4
+  br label %for.cond2
+
+for.cond2:
+  %5 = load i32, i32* %j, align 4
+  %cmp3 = icmp slt i32 %5, 3
+  br i1 %cmp3, label %for.body4, label %for.end8
+
+for.body4:
+  %6 = load i32, i32* %rank, align 4
+  %cmp5 = icmp eq i32 %6, 0
+  br i1 %cmp5, label %if.then, label %if.else
+
+if.then:
+  %7 = bitcast i32* %acc to i8*
+  %call6 = call i32 @MPI_Send(i8* %7, i32 1, i32 1275069445, i32 1, i32 0, i32 1140850688)
+  br label %if.end
+
+if.else:
+  %8 = bitcast i32* %acc to i8*
+  %call7 = call i32 @MPI_Recv(i8* %8, i32 1, i32 1275069445, i32 0, i32 0, i32 1140850688, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  br label %if.end
+
+if.end:
+  br label %for.inc5
+
+for.inc5:
+  %9 = load i32, i32* %j, align 4
+  %inc6 = add nsw i32 %9, 1
+  store i32 %inc6, i32* %j, align 4
+  br label %for.cond2
+
+for.end8:
+  %call9 = call i32 @MPI_Finalize()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Recv(i8*, i32, i32, i32, i32, i32, %struct.MPI_Status*)
+declare dso_local i32 @MPI_Finalize()
@@ -0,0 +1,82 @@
+; MPI is initialized and finalized by helper functions called from main
+;
+;   int setup(int *argc, char ***argv) { MPI_Init(argc, argv); int rank; MPI_Comm_rank(MPI_COMM_WORLD, &rank); return rank; }
+;   void teardown() { MPI_Finalize(); }
+;
+;   int rank = setup(&argc, &argv);
+;   if (rank == 0)      MPI_Recv(&n, 1, MPI_INT, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+;   else if (rank == 1) MPI_Send(&n, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
+;   teardown();
+;
+; ARGS: -passes generate-mpn-all -nproc 2
+
+source_filename = "helper-init-finalize.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local i32 @_Z5setupPiPPPc(i32* %argc, i8*** %argv) {
+entry:
+  %argc.addr = alloca i32*, align 8
+  %argv.addr = alloca i8***, align 8
+  %rank = alloca i32, align 4
+  store i32* %argc, i32** %argc.addr, align 8
+  store i8*** %argv, i8**** %argv.addr, align 8
+  %0 = load i32*, i32** %argc.addr, align 8
+  %1 = load i8***, i8**** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %0, i8*** %1)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  %2 = load i32, i32* %rank, align 4
+  ret i32 %2
+}
+
+define dso_local void @_Z8teardownv() {
+entry:
+  %call = call i32 @MPI_Finalize()
+  ret void
+}
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %n = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @_Z5setupPiPPPc(i32* %argc.addr, i8*** %argv.addr)
+  store i32 %call, i32* %rank, align 4
+  store i32 42, i32* %n, align 4
+  %0 = load i32, i32* %rank, align 4
+  %cmp = icmp eq i32 %0, 0
+  br i1 %cmp, label %if.then, label %if.else
+
+if.then:
+  %1 = bitcast i32* %n to i8*
+  %call1 = call i32 @MPI_Recv(i8* %1, i32 1, i32 1275069445, i32 1, i32 0, i32 1140850688, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  br label %if.end4
+
+if.else:
+  %2 = load i32, i32* %rank, align 4
+  %cmp2 = icmp eq i32 %2, 1
+  br i1 %cmp2, label %if.then3, label %if.end
+
+if.then3:
+  %3 = bitcast i32* %n to i8*
+  %call4 = call i32 @MPI_Send(i8* %3, i32 1, i32 1275069445, i32 0, i32 0, i32 1140850688)
+  br label %if.end
+
+if.end:
+  br label %if.end4
+
+if.end4:
+  call void @_Z8teardownv()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Recv(i8*, i32, i32, i32, i32, i32, %struct.MPI_Status*)
+declare dso_local i32 @MPI_Finalize()
@@ -0,0 +1,53 @@
+; ranks split into classes by `rank % 2`, the even ones send to their odd neighbours
+;
+;   if (rank % 2 == 0) MPI_Send(&buf, 1, MPI_INT, rank + 1, 0, MPI_COMM_WORLD);
+;   else               MPI_Recv(&buf, 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+;
+; ARGS: -passes generate-mpn-all -nproc 4
+; ARGS: -passes generate-mpn-all -nproc 4 -mpn-symbolic-rank
+
+source_filename = "rank-parity.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %buf = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %argc.addr, i8*** %argv.addr)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  %0 = load i32, i32* %rank, align 4
+  %rem = srem i32 %0, 2
+  %cmp = icmp eq i32 %rem, 0
+  br i1 %cmp, label %if.then, label %if.else
+
+if.then:
+  %1 = bitcast i32* %buf to i8*
+  %2 = load i32, i32* %rank, align 4
+  %add = add nsw i32 %2, 1
+  %call2 = call i32 @MPI_Send(i8* %1, i32 1, i32 1275069445, i32 %add, i32 0, i32 1140850688)
+  br label %if.end
+
+if.else:
+  %3 = bitcast i32* %buf to i8*
+  %4 = load i32, i32* %rank, align 4
+  %sub = sub nsw i32 %4, 1
+  %call3 = call i32 @MPI_Recv(i8* %3, i32 1, i32 1275069445, i32 %sub, i32 0, i32 1140850688, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  br label %if.end
+
+if.end:
+  %call4 = call i32 @MPI_Finalize()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Recv(i8*, i32, i32, i32, i32, i32, %struct.MPI_Status*)
+declare dso_local i32 @MPI_Finalize()
@@ -0,0 +1,78 @@
+; mutually recursive functions sending a message on each level
+;
+;   void ping(int n) { if (n > 0) pong(n); }
+;   void pong(int n) { MPI_Send(&n, 1, MPI_INT, 0, 0, MPI_COMM_WORLD); ping(n - 1); }
+;
+;   if (rank == 0) MPI_Recv(&n, 1, MPI_INT, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+;   else           ping(3);
+;
+; ARGS: -passes generate-mpn-all -nproc 2
+
+source_filename = "recursive-scc.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local void @_Z4pingi(i32 %n) {
+entry:
+  %n.addr = alloca i32, align 4
+  store i32 %n, i32* %n.addr, align 4
+  %0 = load i32, i32* %n.addr, align 4
+  %cmp = icmp sgt i32 %0, 0
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:
+  %1 = load i32, i32* %n.addr, align 4
+  call void @_Z4pongi(i32 %1)
+  br label %if.end
+
+if.end:
+  ret void
+}
+
+define dso_local void @_Z4pongi(i32 %n) {
+entry:
+  %n.addr = alloca i32, align 4
+  store i32 %n, i32* %n.addr, align 4
+  %0 = bitcast i32* %n.addr to i8*
+  %call = call i32 @MPI_Send(i8* %0, i32 1, i32 1275069445, i32 0, i32 0, i32 1140850688)
+  %1 = load i32, i32* %n.addr, align 4
+  %sub = sub nsw i32 %1, 1
+  call void @_Z4pingi(i32 %sub)
+  ret void
+}
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %n = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %argc.addr, i8*** %argv.addr)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  %0 = load i32, i32* %rank, align 4
+  %cmp = icmp eq i32 %0, 0
+  br i1 %cmp, label %if.then, label %if.else
+
+if.then:
+  %1 = bitcast i32* %n to i8*
+  %call2 = call i32 @MPI_Recv(i8* %1, i32 1, i32 1275069445, i32 -2, i32 0, i32 1140850688, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  br label %if.end
+
+if.else:
+  call void @_Z4pingi(i32 3)
+  br label %if.end
+
+if.end:
+  %call3 = call i32 @MPI_Finalize()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Recv(i8*, i32, i32, i32, i32, i32, %struct.MPI_Status*)
+declare dso_local i32 @MPI_Finalize()
@@ -0,0 +1,67 @@
+; the request of a nonblocking receive posted by a wrapper is waited for in main
+;
+;   void post_recv(int *buf, int src, MPI_Request *rqst) { MPI_Irecv(buf, 1, MPI_INT, src, 0, MPI_COMM_WORLD, rqst); }
+;
+;   if (rank == 0) { post_recv(&n, 1, &rqst); MPI_Wait(&rqst, MPI_STATUS_IGNORE); }
+;   else           MPI_Send(&n, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
+;
+; ARGS: -passes generate-mpn-all -nproc 2
+
+source_filename = "wrapper-irecv.cpp"
+
+%struct.MPI_Status = type { i32, i32, i32, i32, i32 }
+
+define dso_local void @_Z9post_recvPiiS_(i32* %buf, i32 %src, i32* %rqst) {
+entry:
+  %buf.addr = alloca i32*, align 8
+  %src.addr = alloca i32, align 4
+  %rqst.addr = alloca i32*, align 8
+  store i32* %buf, i32** %buf.addr, align 8
+  store i32 %src, i32* %src.addr, align 4
+  store i32* %rqst, i32** %rqst.addr, align 8
+  %0 = load i32*, i32** %buf.addr, align 8
+  %1 = bitcast i32* %0 to i8*
+  %2 = load i32, i32* %src.addr, align 4
+  %3 = load i32*, i32** %rqst.addr, align 8
+  %call = call i32 @MPI_Irecv(i8* %1, i32 1, i32 1275069445, i32 %2, i32 0, i32 1140850688, i32* %3)
+  ret void
+}
+
+define dso_local i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %retval = alloca i32, align 4
+  %argc.addr = alloca i32, align 4
+  %argv.addr = alloca i8**, align 8
+  %rank = alloca i32, align 4
+  %n = alloca i32, align 4
+  %rqst = alloca i32, align 4
+  store i32 0, i32* %retval, align 4
+  store i32 %argc, i32* %argc.addr, align 4
+  store i8** %argv, i8*** %argv.addr, align 8
+  %call = call i32 @MPI_Init(i32* %argc.addr, i8*** %argv.addr)
+  %call1 = call i32 @MPI_Comm_rank(i32 1140850688, i32* %rank)
+  %0 = load i32, i32* %rank, align 4
+  %cmp = icmp eq i32 %0, 0
+  br i1 %cmp, label %if.then, label %if.else
+
+if.then:
+  call void @_Z9post_recvPiiS_(i32* %n, i32 1, i32* %rqst)
+  %call2 = call i32 @MPI_Wait(i32* %rqst, %struct.MPI_Status* inttoptr (i64 1 to %struct.MPI_Status*))
+  br label %if.end
+
+if.else:
+  %1 = bitcast i32* %n to i8*
+  %call3 = call i32 @MPI_Send(i8* %1, i32 1, i32 1275069445, i32 0, i32 0, i32 1140850688)
+  br label %if.end
+
+if.end:
+  %call4 = call i32 @MPI_Finalize()
+  ret i32 0
+}
+
+declare dso_local i32 @MPI_Init(i32*, i8***)
+declare dso_local i32 @MPI_Comm_rank(i32, i32*)
+declare dso_local i32 @MPI_Irecv(i8*, i32, i32, i32, i32, i32, i32*)
+declare dso_local i32 @MPI_Wait(i32*, %struct.MPI_Status*)
+declare dso_local i32 @MPI_Send(i8*, i32, i32, i32, i32, i32)
+declare dso_local i32 @MPI_Finalize()